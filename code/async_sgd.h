@@ -0,0 +1,62 @@
+//Copyright[2019][Gaganov Ilya]
+//Licensed under the Apache License, Version 2.0
+
+#pragma once
+
+#include "test_metrics.h"
+#include <iostream>
+#include <vector>
+#include <map>
+#include <string>
+#include <algorithm>
+
+using namespace std;
+
+//the result of neural_network::train_async for the comparison with the synchronous training
+class async_sgd_info
+{
+public:
+	async_sgd_info() : n_steps(0), n_samples(0), n_threads(0), time(0.0), samples_per_second(0.0), loss(0.0),
+		mean_observed_updates(0.0), max_observed_updates(0), max_lead(0), time_waiting(0.0) {}
+
+	void print() const
+	{
+		cout << "async: steps = " << n_steps << " threads = " << n_threads << " time = " << time << " s samples/s = " << samples_per_second
+			<< " loss = " << loss << " updates of other threads: mean = " << mean_observed_updates << " max = " << max_observed_updates
+			<< " lead: max = " << max_lead << " waiting = " << time_waiting << " s";
+		if (metrics.size != 0)
+			cout << " test error = " << metrics.error;
+		cout << endl;
+	}
+
+	//all values by names (for Python)
+	map <string, double> to_map() const
+	{
+		map <string, double> res;
+		res["n_steps"] = static_cast<double>(n_steps);
+		res["n_samples"] = static_cast<double>(n_samples);
+		res["n_threads"] = static_cast<double>(n_threads);
+		res["time"] = time;
+		res["samples_per_second"] = samples_per_second;
+		res["loss"] = loss;
+		res["mean_observed_updates"] = mean_observed_updates;
+		res["max_observed_updates"] = static_cast<double>(max_observed_updates);
+		res["max_lead"] = static_cast<double>(max_lead);
+		res["time_waiting"] = time_waiting;
+		res["test_error"] = metrics.error;
+		return res;
+	}
+
+	size_t n_steps; //mini-batches of all threads
+	size_t n_samples;
+	size_t n_threads;
+	double time;
+	double samples_per_second;
+	double loss; //the mean batch loss of the last tenth of the steps, as training_record::loss
+	vector <double> loss_history; //the mean batch loss of each hundredth of the steps
+	double mean_observed_updates; //the updates of other threads applied between reading the weights and applying the gradient
+	size_t max_observed_updates;
+	size_t max_lead; //mini-batches a thread was ahead of the slowest one, as the bound max_staleness of train_async (0 without the bound)
+	double time_waiting; //the time of all threads waiting because of the bound of staleness
+	test_metrics metrics; //testing on settings.part_for_test of the data after training
+};
\ No newline at end of file
@@ -0,0 +1,54 @@
+//Copyright[2019][Gaganov Ilya]
+//Licensed under the Apache License, Version 2.0
+
+//the check of the asynchronous training: make check_async (or g++ -std=c++11 -O2 -fopenmp async_sgd_check.cpp -o async_sgd_check)
+//train_async without the bound of staleness and with it must make all mini-batches and decrease the loss,
+//with the bound no thread may be more than max_staleness mini-batches ahead of the slowest one
+//exit code: 0 - passed, 1 - failed
+
+#include "foxnn.h"
+
+int main()
+{
+	train_data data;
+	random_generator generator(1);
+	vector <double> input(8), out(2);
+	for (size_t i = 0; i < 512; ++i)
+	{
+		for (size_t j = 0; j < input.size(); ++j)
+			input[j] = generator.uniform(-1.0, 1.0);
+		out[0] = (input[0] + input[1] > 0.0) ? 1.0 : 0.0;
+		out[1] = 1.0 - out[0];
+		data.add_data(input, out);
+	}
+
+	bool passed = true;
+	const size_t max_iteration = 2000;
+	const vector <size_t> bounds = { 0, 1, 4 };
+	for (size_t i = 0; i < bounds.size(); ++i)
+	{
+		random_seed::set(0);
+		neural_network nn(vector<int>{ 8, 16, 2 });
+		nn.settings.n_threads = 4;
+		nn.settings.print_progress = 0;
+		const async_sgd_info info = nn.train_async(data, 0.05, max_iteration, 8, bounds[i]);
+		cout << "max_staleness = " << bounds[i] << ": ";
+		info.print();
+		string error;
+		if (info.n_steps != max_iteration)
+			error = "not all mini-batches were made";
+		else if (info.loss_history.size() == 0 || !(info.loss < info.loss_history.front()))
+			error = "the loss did not decrease";
+		else if (bounds[i] != 0 && info.max_lead > bounds[i])
+			error = "a thread was too far ahead";
+		else if (bounds[i] == 0 && info.max_lead != 0)
+			error = "the lead was measured without the bound";
+		if (error.size() != 0)
+		{
+			cout << "failed: " << error << endl;
+			passed = false;
+		}
+	}
+	cout << ((passed == true) ? "passed" : "failed") << endl;
+	return (passed == true) ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+//Copyright[2019][Gaganov Ilya]
+//Licensed under the Apache License, Version 2.0
+
+#pragma once
+
+#include "test_metrics.h"
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <functional>
+
+using namespace std;
+
+//the number of threads of the library running in the background (async_testing, inference_server, model_handle::load_async),
+//shm_trainer does not fork while there are any; add is called before the thread is started,
+//the thread creates a guard at the beginning of its function, so it is counted until the function returns
+class background_threads
+{
+public:
+	static void add()
+	{
+		counter()++;
+	}
+
+	static size_t get_n_running()
+	{
+		return counter().load();
+	}
+
+	class guard
+	{
+	public:
+		guard() {}
+		~guard()
+		{
+			counter()--;
+		}
+		guard(const guard &) = delete;
+		guard& operator= (const guard &) = delete;
+	};
+
+private:
+	static atomic <size_t>& counter()
+	{
+		static atomic <size_t> n(0);
+		return n;
+	}
+};
+
+//testing in a separate thread during training: one task at a time, the result is taken by the training thread
+class async_testing
+{
+public:
+	async_testing() : busy(false), ready(false) {}
+
+	~async_testing()
+	{
+		wait();
+	}
+
+	bool is_busy() const
+	{
+		return busy.load(memory_order_acquire);
+	}
+
+	//start the task if the previous one is finished, returns false if it is not finished
+	bool start(const function<test_metrics()> &task)
+	{
+		if (is_busy())
+			return false;
+		wait();
+		busy.store(true, memory_order_release);
+		background_threads::add();
+		worker = thread([this, task]()
+			{
+				const background_threads::guard running;
+				test_metrics res = task();
+				{
+					lock_guard <mutex> lock(mutex_result);
+					result = move(res);
+					ready = true;
+				}
+				busy.store(false, memory_order_release);
+			});
+		return true;
+	}
+
+	//take the result of the finished task, returns false if there is no new result
+	bool get_result(test_metrics &res)
+	{
+		lock_guard <mutex> lock(mutex_result);
+		if (ready == false)
+			return false;
+		res = move(result);
+		ready = false;
+		return true;
+	}
+
+	void wait()
+	{
+		if (worker.joinable())
+			worker.join();
+	}
+
+private:
+	thread worker;
+	atomic <bool> busy;
+	mutex mutex_result;
+	test_metrics result;
+	bool ready;
+};
\ No newline at end of file
@@ -0,0 +1,300 @@
+//Copyright[2019][Gaganov Ilya]
+//Licensed under the Apache License, Version 2.0
+
+#pragma once
+
+#include "foxnn.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <functional>
+#include <omp.h>
+
+using namespace std;
+
+//the settings chosen by autotuner for one processor, topology and batch
+class autotune_result
+{
+public:
+	autotune_result() : n_threads(1), size_block(256), batched_inference(true), min_parallel_work(100000),
+		ns_train(0.0), ns_inference(0.0), from_cache(false) {}
+
+	void apply(Settings &settings) const
+	{
+		settings.n_threads = n_threads;
+		settings.size_block = size_block;
+		settings.batched_inference = batched_inference;
+		settings.min_parallel_work = min_parallel_work;
+	}
+
+	void print() const
+	{
+		cout << "autotune: n_threads = " << n_threads << " size_block = " << size_block << " batched_inference = " << batched_inference
+			<< " min_parallel_work = " << min_parallel_work << " train = " << ns_train << " ns/step inference = " << ns_inference << " ns/batch"
+			<< ((from_cache == true) ? " (cache)" : "") << endl;
+	}
+
+	string key;
+	size_t n_threads;
+	size_t size_block;
+	bool batched_inference;
+	size_t min_parallel_work;
+	double ns_train; //one step of training on the batch with the chosen settings
+	double ns_inference; //get_out_batch of the batch with the chosen settings
+	bool from_cache; //the result was read from the file, nothing was measured
+};
+
+//the choice of Settings::n_threads, size_block, batched_inference and min_parallel_work by measuring the candidates
+//on a copy of the network with random examples; the results are kept in a file by the key of the processor, the topology and the batch,
+//so the measurement is done once for each kind of machine
+class autotuner
+{
+public:
+	autotuner(const string &new_name_file = "autotune_cache.txt") : name_file(new_name_file), min_time(0.01), n_repeats(3), verbose(false) {}
+
+	//the settings of nn are changed to the fastest ones, use_cache = false - measured again and the file is updated
+	autotune_result tune(neural_network &nn, const size_t &size_batch, const bool &use_cache = true)
+	{
+		autotune_result res;
+		if (nn.layers.size() == 0 || size_batch == 0)
+		{
+			cout << "no layers or the batch is empty" << endl;
+			return res;
+		}
+		const string key = get_key(nn, size_batch);
+		if (use_cache == false || load(key, res) == false)
+		{
+			res = measure_all(nn, size_batch);
+			res.key = key;
+			save(res);
+		}
+		res.apply(nn.settings);
+		if (verbose == true)
+			res.print();
+		return res;
+	}
+
+	//the processor, the number of its threads, the sizes of the layers, the batch and correct_summation, without spaces
+	string get_key(const neural_network &nn, const size_t &size_batch) const
+	{
+		ostringstream res;
+		res << get_cpu_model() << ";threads=" << omp_get_num_procs() << ";topology=" << nn.get_N_in();
+		for (size_t i = 0; i < nn.layers.size(); ++i)
+			res << "," << nn.layers[i]->get_N_n();
+		res << ";batch=" << size_batch << ";correct_summation=" << nn.settings.correct_summation;
+		return res.str();
+	}
+
+	//"model name" of /proc/cpuinfo (Linux); on ARM, where there is no such line, "CPU implementer" and "CPU part"
+	//of /proc/cpuinfo or MIDR_EL1 of the processor 0 from /sys; "unknown" if none of them is found
+	static string get_cpu_model()
+	{
+		string implementer, part;
+		{
+			ifstream file("/proc/cpuinfo");
+			string line;
+			while (getline(file, line))
+			{
+				const size_t colon = line.find(':');
+				if (colon == string::npos)
+					continue;
+				string value = line.substr(min(line.find_first_not_of(" \t", colon + 1), line.size()));
+				replace_if(value.begin(), value.end(), [](const char &c) { return c == ' ' || c == '\t' || c == ';'; }, '_');
+				if (line.compare(0, 10, "model name") == 0 && value.size() != 0)
+					return value;
+				if (line.compare(0, 15, "CPU implementer") == 0 && implementer.size() == 0)
+					implementer = value;
+				if (line.compare(0, 8, "CPU part") == 0 && part.size() == 0)
+					part = value;
+			}
+		}
+		if (implementer.size() != 0 && part.size() != 0)
+			return "implementer=" + implementer + ",part=" + part;
+
+		ifstream file("/sys/devices/system/cpu/cpu0/regs/identification/midr_el1");
+		string midr;
+		if (file >> midr)
+			return "midr=" + midr;
+		return "unknown";
+	}
+
+	string name_file; //one line for each key: key n_threads size_block batched_inference min_parallel_work ns_train ns_inference
+	double min_time; //the minimum time of measuring one candidate in seconds
+	size_t n_repeats; //the median of n_repeats measurements is compared
+	bool verbose; //printing the time of each candidate
+
+	vector <size_t> blocks = { 0, 64, 128, 256, 512, 1024 }; //the candidates of size_block, 0 - one block
+	vector <size_t> works = { 0, 10000, 100000, 1000000, numeric_limits<size_t>::max() }; //the candidates of min_parallel_work
+
+private:
+	autotune_result measure_all(const neural_network &nn, const size_t &size_batch)
+	{
+		neural_network copy(nn, false);
+		copy.settings.print_progress = 0;
+		copy.settings.profiling = 0;
+		copy.settings.tracing = 0;
+
+		//random examples from a separate generator, so the sequence of the library is not changed by tuning;
+		//the speed of training is 0, so the weights do not change
+		const size_t N_in = nn.get_N_in();
+		const size_t N_out = nn.get_N_out();
+		random_generator generator(1);
+		train_data data;
+		data.reserve(size_batch);
+		vector <double> input(N_in), out(N_out);
+		for (size_t i = 0; i < size_batch; ++i)
+		{
+			for (size_t j = 0; j < N_in; ++j)
+				input[j] = generator.uniform(-1.0, 1.0);
+			for (size_t j = 0; j < N_out; ++j)
+				out[j] = generator.uniform(0.0, 1.0);
+			data.add_data(input, out);
+		}
+		train_data batch = data.get_first_n(size_batch);
+		vector <double> in(size_batch * N_in), res_batch(size_batch * N_out);
+		for (size_t i = 0; i < size_batch; ++i)
+			copy_n(data[i]->input.cbegin(), N_in, in.begin() + i * N_in);
+
+		auto train_step = [&]()
+		{
+			copy.init_memory_for_train(size_batch);
+			const double res = measure("train", copy.settings, [&]() { copy.train_nn(batch, 0.0); });
+			copy.delete_memory_after_train();
+			return res;
+		};
+		auto inference = [&]()
+		{
+			return measure("inference", copy.settings, [&]() { copy.get_out_batch(in.data(), size_batch, N_in, res_batch.data(), size_batch, N_out); });
+		};
+
+		//the parameters are chosen one after another, each with the best values of the previous ones
+		autotune_result res;
+		res.apply(copy.settings);
+		const size_t max_threads = max(omp_get_num_procs(), 1);
+		vector <size_t> threads;
+		for (size_t t = 1; t < max_threads; t *= 2)
+			threads.push_back(t);
+		threads.push_back(max_threads);
+		res.ns_train = numeric_limits<double>::max();
+		for (size_t i = 0; i < threads.size(); ++i)
+			choose(copy.settings.n_threads, threads[i], res.n_threads, res.ns_train, train_step);
+		copy.settings.n_threads = res.n_threads;
+		for (size_t i = 0; i < blocks.size(); ++i)
+			choose(copy.settings.size_block, blocks[i], res.size_block, res.ns_train, train_step);
+		copy.settings.size_block = res.size_block;
+
+		//without correct_summation: example by example, or layer by layer with the candidates of the threshold of threads
+		res.ns_inference = numeric_limits<double>::max();
+		copy.settings.batched_inference = false;
+		const double ns_per_row = inference();
+		if (nn.settings.correct_summation == false)
+		{
+			copy.settings.batched_inference = true;
+			for (size_t i = 0; i < works.size(); ++i)
+				choose(copy.settings.min_parallel_work, works[i], res.min_parallel_work, res.ns_inference, inference);
+		}
+		if (ns_per_row < res.ns_inference)
+		{
+			res.batched_inference = false;
+			res.ns_inference = ns_per_row;
+		}
+		return res;
+	}
+
+	//value is set to candidate and measured, best and time_best are replaced if it is faster
+	template <typename T>
+	static void choose(T &value, const T &candidate, T &best, double &time_best, const function<double()> &measure_candidate)
+	{
+		value = candidate;
+		const double time = measure_candidate();
+		if (time < time_best)
+		{
+			best = candidate;
+			time_best = time;
+		}
+	}
+
+	//the median time of one call in ns, the number of calls is doubled until they take min_time
+	double measure(const string &name, const Settings &settings, const function<void()> &f) const
+	{
+		f();
+		size_t n_ops = 1;
+		double time = 0.0;
+		while (true)
+		{
+			time = omp_get_wtime();
+			for (size_t i = 0; i < n_ops; ++i)
+				f();
+			time = omp_get_wtime() - time;
+			if (time >= min_time || n_ops >= (static_cast<size_t>(1) << 20))
+				break;
+			n_ops *= 2;
+		}
+		vector <double> runs(1, time * 1e9 / n_ops);
+		for (size_t k = 1; k < n_repeats; ++k)
+		{
+			time = omp_get_wtime();
+			for (size_t i = 0; i < n_ops; ++i)
+				f();
+			runs.push_back((omp_get_wtime() - time) * 1e9 / n_ops);
+		}
+		sort(runs.begin(), runs.end());
+		const size_t N = runs.size();
+		const double res = (N % 2 == 1) ? runs[N / 2] : (runs[N / 2 - 1] + runs[N / 2]) / 2.0;
+		if (verbose == true)
+			cout << "autotune " << name << ": n_threads = " << settings.n_threads << " size_block = " << settings.size_block
+				<< " batched_inference = " << settings.batched_inference << " min_parallel_work = " << settings.min_parallel_work << ": " << res << " ns" << endl;
+		return res;
+	}
+
+	bool load(const string &key, autotune_result &res) const
+	{
+		ifstream file(name_file);
+		string line;
+		while (getline(file, line))
+		{
+			istringstream stream(line);
+			autotune_result r;
+			if (!(stream >> r.key >> r.n_threads >> r.size_block >> r.batched_inference >> r.min_parallel_work >> r.ns_train >> r.ns_inference))
+				continue;
+			if (r.key == key)
+			{
+				r.from_cache = true;
+				res = r;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//the line of the key is replaced, the lines of other keys are kept
+	void save(const autotune_result &res) const
+	{
+		vector <string> lines;
+		{
+			ifstream file(name_file);
+			string line;
+			while (getline(file, line))
+			{
+				istringstream stream(line);
+				string key;
+				if (stream >> key && key != res.key)
+					lines.push_back(line);
+			}
+		}
+		ofstream file(name_file);
+		if (!file.is_open())
+		{
+			cout << "failed to open file " << name_file << endl;
+			return;
+		}
+		for (size_t i = 0; i < lines.size(); ++i)
+			file << lines[i] << endl;
+		file << res.key << " " << res.n_threads << " " << res.size_block << " " << res.batched_inference << " " << res.min_parallel_work
+			<< " " << res.ns_train << " " << res.ns_inference << endl;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,24 @@
+//Copyright[2019][Gaganov Ilya]
+//Licensed under the Apache License, Version 2.0
+
+//benchmarks of the library: make benchmark (or g++ -std=c++11 -O2 -fopenmp benchmark.cpp -o benchmark)
+//usage: benchmark [name_file_json] [min_time] [micro|macro|all]
+
+#include "benchmark.h"
+
+int main(int argc, char** argv)
+{
+	const string name_file = (argc > 1) ? argv[1] : "benchmark.json";
+	const string part = (argc > 3) ? argv[3] : "all";
+
+	benchmark b;
+	if (argc > 2)
+		b.min_time = atof(argv[2]);
+
+	if (part == "micro" || part == "all")
+		b.run_micro();
+	if (part == "macro" || part == "all")
+		b.run_macro(b.topologies, b.batches, b.threads);
+
+	return (b.save_json(name_file) == true) ? 0 : 1;
+}
@@ -0,0 +1,285 @@
+//Copyright[2019][Gaganov Ilya]
+//Licensed under the Apache License, Version 2.0
+
+#pragma once
+
+#include "foxnn.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include <functional>
+#include <omp.h>
+
+using namespace std;
+
+//the result of one case: the time of one operation in each repeat, the median is the main value
+class benchmark_result
+{
+public:
+	benchmark_result() : n_ops(0), ns_per_op(0.0), samples_per_second(0.0), samples_per_op(0.0) {}
+
+	string name;
+	map <string, string> parameters;
+	size_t n_ops; //operations in one repeat
+	double ns_per_op; //the median over the repeats
+	double samples_per_second; //0 - the case does not process examples
+	double samples_per_op;
+	vector <double> runs; //ns per operation of each repeat
+};
+
+//micro benchmarks of the kernels and macro benchmarks of training and inference,
+//the results are printed and saved as JSON (see benchmark.cpp)
+class benchmark
+{
+public:
+	benchmark() : min_time(0.2), n_repeats(5), verbose(true), name_file_tmp("benchmark_tmp.txt") {}
+
+	void run_all()
+	{
+		run_micro();
+		run_macro(topologies, batches, threads);
+	}
+
+	//the kernels of one layer and the input / output of files
+	void run_micro()
+	{
+		for (size_t k = 0; k < sizes.size(); ++k)
+		{
+			const size_t N = sizes[k];
+			vector <double> enter(N);
+			random_generator_fill(enter);
+			map <string, string> parameters = { {"N_in", to_string(N)}, {"N_out", to_string(N)} };
+
+			neuron n(N);
+			double sink = 0.0;
+			measure("neuron::scalar_product", parameters, 0, [&]() { sink += n.scalar_product(enter, false); });
+			measure("neuron::scalar_product_correct_summation", parameters, 0, [&]() { sink += n.scalar_product(enter, true); });
+
+			layer l(N, N);
+			vector <double> out;
+			measure("layer::get_out", parameters, 1, [&]() { l.get_out(enter, out); });
+
+			const vector<string> modes = { "SGD", "Adam", "Nesterov" };
+			for (size_t m = 0; m < modes.size(); ++m)
+			{
+				Settings settings;
+				settings.set_mode(modes[m]);
+				l.init_memory_for_train(1, settings);
+				workspace memory;
+				memory.reserve(l.get_size_workspace(false));
+				vector <double> error(N, 0.001);
+				map <string, string> parameters_mode = parameters;
+				parameters_mode["mode"] = modes[m];
+				if (m == 0)
+					measure("layer::back_running", parameters, 1, [&]() { memory.reset(); l.back_running(error.data(), enter, settings, memory); });
+				measure("layer::correction_of_scales", parameters_mode, 0, [&]() { l.correction_of_scales(1e-9, settings); });
+				l.delete_memory_after_train();
+			}
+			if (sink == 1.0) //the result is used so the calculation is not removed by the compiler
+				cout << "";
+		}
+
+		train_data data = get_data(10000, 32, 4);
+		map <string, string> parameters = { {"size", "10000"}, {"N_in", "32"}, {"N_out", "4"} };
+		measure("train_data::save", parameters, 10000, [&]() { data.save(name_file_tmp); });
+		measure("train_data::load", parameters, 10000, [&]() { train_data loaded(name_file_tmp); });
+		for (size_t k = 0; k < batches.size(); ++k)
+			measure("train_data::get_part", { {"size_batch", to_string(batches[k])} }, batches[k], [&]() { data.get_part(batches[k]); });
+
+		neural_network nn(vector<int>{ 256, 256, 64 });
+		parameters = { {"topology", "256,256,64"} };
+		measure("neural_network::save", parameters, 0, [&]() { nn.save(name_file_tmp); });
+		measure("neural_network::load", parameters, 0, [&]() { neural_network loaded(name_file_tmp); });
+		remove(name_file_tmp.c_str());
+	}
+
+	//training (one operation - iterations_train iterations on a batch) and inference (one operation - one example)
+	void run_macro(const vector<vector<int>> &topologies_macro, const vector<size_t> &batches_macro, const vector<size_t> &threads_macro)
+	{
+		for (size_t t = 0; t < topologies_macro.size(); ++t)
+		{
+			const vector<int> &topology = topologies_macro[t];
+			train_data data = get_data(1000, topology.front(), topology.back());
+			neural_network nn(topology);
+			nn.settings.set_part_for_test(0);
+			nn.settings.n_print = 0;
+
+			for (size_t k = 0; k < threads_macro.size(); ++k)
+			{
+				nn.settings.n_threads = threads_macro[k];
+				for (size_t b = 0; b < batches_macro.size(); ++b)
+				{
+					const size_t size_batch = batches_macro[b];
+					map <string, string> parameters = { {"topology", to_string(topology)}, {"size_batch", to_string(size_batch)}, {"n_threads", to_string(threads_macro[k])} };
+					measure("neural_network::train", parameters, static_cast<double>(size_batch * iterations_train), [&]() { nn.train(data, 1e-6, iterations_train, size_batch); });
+				}
+			}
+
+			vector <double> out, enter;
+			size_t i = 0;
+			map <string, string> parameters = { {"topology", to_string(topology)} };
+			measure("neural_network::get_out", parameters, 1, [&]() { nn.get_out(data[i++ % data.size()]->input, out, enter); });
+		}
+	}
+
+	void print() const
+	{
+		for (size_t i = 0; i < results.size(); ++i)
+			print(results[i]);
+	}
+
+	static void print(const benchmark_result &r)
+	{
+		cout << r.name;
+		for (auto it = r.parameters.cbegin(); it != r.parameters.cend(); ++it)
+			cout << " " << it->first << "=" << it->second;
+		cout << ": " << r.ns_per_op << " ns/op";
+		if (r.samples_per_second != 0.0)
+			cout << " " << r.samples_per_second << " samples/s";
+		cout << endl;
+	}
+
+	string to_json() const
+	{
+		ostringstream res;
+		res.precision(10);
+		res << "{\"host\":{\"max_threads\":" << omp_get_max_threads() << ",\"compiler\":\"" << get_compiler() << "\"}," << endl;
+		res << "\"results\":[" << endl;
+		for (size_t i = 0; i < results.size(); ++i)
+		{
+			const benchmark_result &r = results[i];
+			res << "{\"name\":\"" << r.name << "\",\"parameters\":{";
+			for (auto it = r.parameters.cbegin(); it != r.parameters.cend(); ++it)
+				res << ((it == r.parameters.cbegin()) ? "" : ",") << "\"" << it->first << "\":\"" << it->second << "\"";
+			res << "},\"n_ops\":" << r.n_ops << ",\"ns_per_op\":" << r.ns_per_op << ",\"samples_per_second\":" << r.samples_per_second << ",\"runs\":[";
+			for (size_t j = 0; j < r.runs.size(); ++j)
+				res << ((j == 0) ? "" : ",") << r.runs[j];
+			res << "]}" << ((i + 1 == results.size()) ? "" : ",") << endl;
+		}
+		res << "]}" << endl;
+		return res.str();
+	}
+
+	bool save_json(const string &name_file) const
+	{
+		ofstream file(name_file);
+		if (!file.is_open())
+		{
+			cout << "failed to open file " << name_file << endl;
+			return false;
+		}
+		file << to_json();
+		return true;
+	}
+
+	vector <benchmark_result> results;
+	double min_time; //the minimum time of one repeat in seconds
+	size_t n_repeats;
+	bool verbose; //printing each result as soon as it is measured
+	string name_file_tmp; //the file for the cases of saving and loading
+
+	vector <size_t> sizes = { 64, 256, 1024 }; //the sizes of the layers of the micro benchmarks
+	vector <vector<int>> topologies = { {32, 64, 4}, {256, 256, 64}, {784, 256, 10} };
+	vector <size_t> batches = { 1, 32, 256 };
+	vector <size_t> threads = { 1, 2, 4 };
+	size_t iterations_train = 10; //the iterations of one call of train, the preparation of training is included in the time
+
+private:
+	//samples_per_op - the number of examples processed by one call, 0 - the case does not process examples
+	void measure(const string &name, const map <string, string> &parameters, const double &samples_per_op, const function<void()> &f)
+	{
+		benchmark_result r;
+		r.name = name;
+		r.parameters = parameters;
+		r.samples_per_op = samples_per_op;
+
+		//the number of calls in one repeat is doubled until the repeat takes min_time
+		f();
+		size_t n_ops = 1;
+		double time = 0.0;
+		while (true)
+		{
+			time = omp_get_wtime();
+			for (size_t i = 0; i < n_ops; ++i)
+				f();
+			time = omp_get_wtime() - time;
+			if (time >= min_time || n_ops >= (static_cast<size_t>(1) << 30))
+				break;
+			n_ops = (time <= 0.0) ? n_ops * 2 : max(n_ops * 2, min(static_cast<size_t>(n_ops * 1.2 * min_time / time), n_ops * 100));
+		}
+
+		r.n_ops = n_ops;
+		r.runs.push_back(time * 1e9 / n_ops);
+		for (size_t k = 1; k < n_repeats; ++k)
+		{
+			time = omp_get_wtime();
+			for (size_t i = 0; i < n_ops; ++i)
+				f();
+			r.runs.push_back((omp_get_wtime() - time) * 1e9 / n_ops);
+		}
+
+		vector <double> sorted = r.runs;
+		sort(sorted.begin(), sorted.end());
+		const size_t N = sorted.size();
+		r.ns_per_op = (N % 2 == 1) ? sorted[N / 2] : (sorted[N / 2 - 1] + sorted[N / 2]) / 2.0;
+		if (samples_per_op != 0.0 && r.ns_per_op > 0.0)
+			r.samples_per_second = samples_per_op * 1e9 / r.ns_per_op;
+		results.push_back(r);
+		if (verbose == true)
+			print(r);
+	}
+
+	static void random_generator_fill(vector <double> &v)
+	{
+		random_generator &generator = get_random_generator();
+		for (size_t i = 0; i < v.size(); ++i)
+			v[i] = generator.uniform(-1.0, 1.0);
+	}
+
+	static train_data get_data(const size_t &size, const size_t &N_input, const size_t &N_out)
+	{
+		train_data res;
+		res.reserve(size);
+		vector <double> input(N_input), out(N_out);
+		for (size_t i = 0; i < size; ++i)
+		{
+			random_generator_fill(input);
+			fill(out.begin(), out.end(), 0.0);
+			out[i % N_out] = 1.0;
+			res.add_data(input, out);
+		}
+		return res;
+	}
+
+	static string to_string(const vector<int> &topology)
+	{
+		string res;
+		for (size_t i = 0; i < topology.size(); ++i)
+			res += ((i == 0) ? "" : ",") + std::to_string(topology[i]);
+		return res;
+	}
+
+	static string to_string(const size_t &value)
+	{
+		return std::to_string(value);
+	}
+
+	static string get_compiler()
+	{
+#if defined(__clang__)
+		return "clang " __clang_version__;
+#elif defined(__GNUC__)
+		return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+		return "msvc " + std::to_string(_MSC_VER);
+#else
+		return "unknown";
+#endif
+	}
+};
\ No newline at end of file
@@ -0,0 +1,220 @@
+//Copyright[2019][Gaganov Ilya]
+//Licensed under the Apache License, Version 2.0
+
+#pragma once
+
+#include "foxnn.h"
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <omp.h>
+#include <algorithm>
+#include <numeric>
+
+using namespace std;
+
+//ensemble of networks with the same topology, calculated in one pass over the layers
+//the layers of all members are stacked into one matrix: the row of neuron n of member m is m * N_out + n,
+//the first layer of all members is one product of the matrix by the common input
+class ensemble
+{
+public:
+	ensemble() : n_threads(1), min_parallel_work(100000), N_members(0), mode("mean") {}
+
+	//adding a member with the weight for the "weighted" mode, the weights of the member are copied
+	void add(const neural_network &member, const double &weight = 1.0)
+	{
+		if (member.layers.size() == 0)
+			return;
+		if (N_members == 0)
+		{
+			layers.resize(member.layers.size());
+			for (size_t i = 0; i < layers.size(); ++i)
+			{
+				layers[i].N_in = member.layers[i]->get_N_w();
+				layers[i].N_out = member.layers[i]->get_N_n();
+			}
+		}
+		else if (check_topology(member) == false)
+		{
+			cout << "the topology of the network does not match the ensemble" << endl;
+			return;
+		}
+
+		for (size_t i = 0; i < layers.size(); ++i)
+		{
+			stacked_layer &l = layers[i];
+			l.w.resize(l.w.size() + member.layers[i]->get_N_weights());
+			member.layers[i]->get_weights(l.w.data() + N_members * l.N_out * (l.N_in + 1));
+			l.functions.push_back(get_activation_function(member.layers[i]->res_function));
+		}
+		member_settings.push_back(member.settings);
+		weights.push_back(weight);
+		N_members++;
+	}
+
+	//"mean" - the mean of the outputs, "weighted" - the weighted mean, "vote" - the share of members for which the output is maximum
+	void set_mode(const string &next_mode)
+	{
+		if (next_mode != "mean" and next_mode != "weighted" and next_mode != "vote")
+			mode = "mean";
+		else
+			mode = next_mode;
+	}
+
+	vector<double> get_out(const vector<double> &first_in) const
+	{
+		vector <double> out;
+		if (check_input(first_in) == false)
+			return out;
+		get_out(first_in.data(), 1, out);
+		return out;
+	}
+
+	//the outputs for the batch of inputs, the weights of each row are read once for the whole batch
+	vector<vector<double>> get_out_batch(const vector<vector<double>> &first_in) const
+	{
+		vector<vector<double>> res(first_in.size());
+		if (first_in.size() == 0 || N_members == 0)
+			return res;
+		for (size_t i = 0; i < first_in.size(); ++i)
+			if (check_input(first_in[i]) == false)
+				return res;
+
+		const size_t N_input = layers[0].N_in;
+		vector <double> input(first_in.size() * N_input);
+		for (size_t i = 0; i < first_in.size(); ++i)
+			copy(first_in[i].cbegin(), first_in[i].cbegin() + N_input, input.begin() + i * N_input);
+
+		vector <double> out;
+		get_out(input.data(), first_in.size(), out);
+
+		const size_t N_out = layers.back().N_out;
+		for (size_t i = 0; i < first_in.size(); ++i)
+			res[i].assign(out.cbegin() + i * N_out, out.cbegin() + (i + 1) * N_out);
+		return res;
+	}
+
+	//first_in - N_batch inputs one after another, out - N_batch reduced outputs one after another
+	void get_out(const double* first_in, const size_t &N_batch, vector<double> &out) const
+	{
+		out.clear();
+		if (N_members == 0)
+			return;
+
+		vector <double> enter;
+		vector <double> layer_out;
+		const double* in = first_in;
+		for (size_t i = 0; i < layers.size(); ++i)
+		{
+			get_out_layer(i, in, N_batch, layer_out);
+			enter.swap(layer_out);
+			in = enter.data();
+		}
+		reduce(enter, N_batch, out);
+	}
+
+	size_t size() const
+	{
+		return N_members;
+	}
+
+	size_t n_threads;
+	size_t min_parallel_work; //a layer is calculated by several threads if rows * examples * inputs is greater, see Settings::min_parallel_work
+
+private:
+
+	struct stacked_layer
+	{
+		size_t N_in;
+		size_t N_out;
+		vector <double> w; //N_members * N_out rows of N_in + 1 weights
+		vector <activation_function> functions; //activation function of each member
+	};
+
+	bool check_input(const vector<double> &first_in) const
+	{
+		if (N_members != 0 && first_in.size() != layers[0].N_in)
+		{
+			cout << "the size of the input does not match the ensemble" << endl;
+			return false;
+		}
+		return true;
+	}
+
+	bool check_topology(const neural_network &member) const
+	{
+		if (member.layers.size() != layers.size())
+			return false;
+		for (size_t i = 0; i < layers.size(); ++i)
+			if (member.layers[i]->get_N_w() != layers[i].N_in || member.layers[i]->get_N_n() != layers[i].N_out)
+				return false;
+		return true;
+	}
+
+	//in - N_batch inputs of the layer: for the first layer the common input, otherwise the outputs of all members one after another
+	void get_out_layer(const size_t &num_layer, const double* in, const size_t &N_batch, vector <double> &out) const
+	{
+		const stacked_layer &l = layers[num_layer];
+		const size_t N_in = l.N_in;
+		const size_t N_rows = N_members * l.N_out;
+		const size_t stride_in = (num_layer == 0) ? N_in : N_members * N_in;
+		out.resize(N_batch * N_rows);
+		double* const res = out.data();
+
+#pragma omp parallel for num_threads(n_threads) if(N_rows * N_batch * N_in > min_parallel_work)
+		for (long long r = 0; r < static_cast<long long>(N_rows); ++r)
+		{
+			const size_t m = r / l.N_out;
+			const double* const w = &l.w[r * (N_in + 1)];
+			const double* x = in + ((num_layer == 0) ? 0 : m * N_in);
+			for (size_t b = 0; b < N_batch; ++b, x += stride_in)
+			{
+				double sum = 0.0;
+#pragma omp simd reduction(+:sum)
+				for (size_t i = 0; i < N_in; ++i)
+					sum += w[i] * x[i];
+				sum += -w[N_in];
+				res[b * N_rows + r] = l.functions[m]->get_out(sum);
+			}
+		}
+	}
+
+	void reduce(vector <double> &last_out, const size_t &N_batch, vector <double> &out) const
+	{
+		const size_t N_out = layers.back().N_out;
+		const size_t N_rows = N_members * N_out;
+		out.assign(N_batch * N_out, 0.0);
+
+		for (size_t b = 0; b < N_batch; ++b)
+		{
+			double* const res = &out[b * N_out];
+			double sum_weights = 0.0;
+			for (size_t m = 0; m < N_members; ++m)
+			{
+				double* const member_out = &last_out[b * N_rows + m * N_out];
+				neural_network::correction_out(member_out, N_out, member_settings[m]);
+				if (mode == "vote")
+				{
+					res[distance(member_out, max_element(member_out, member_out + N_out))] += 1.0;
+					sum_weights += 1.0;
+					continue;
+				}
+				const double weight = (mode == "weighted") ? weights[m] : 1.0;
+				for (size_t j = 0; j < N_out; ++j)
+					res[j] += weight * member_out[j];
+				sum_weights += weight;
+			}
+			if (sum_weights != 0.0)
+				for (size_t j = 0; j < N_out; ++j)
+					res[j] /= sum_weights;
+		}
+	}
+
+	vector <stacked_layer> layers;
+	vector <Settings> member_settings;
+	vector <double> weights;
+	size_t N_members;
+	string mode;
+};
\ No newline at end of file
@@ -0,0 +1,295 @@
+//Copyright[2019][Gaganov Ilya]
+//Licensed under the Apache License, Version 2.0
+
+#pragma once
+
+#include "foxnn.h"
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <omp.h>
+#include <algorithm>
+#include <numeric>
+#include <functional>
+#include <limits>
+
+using namespace std;
+
+//population of networks with the same topology for training without gradients
+//the weights of all individuals are stored in one array: the individual k occupies pool[k * N_weights .. (k + 1) * N_weights)
+class evolution
+{
+public:
+	//population of size_population individuals: the first one is sample, the others are its random mutations
+	evolution(const neural_network &sample, const size_t &size_population, const double &speed = 0.1) : network(sample)
+	{
+		network.settings = sample.settings;
+		N_weights = network.get_N_weights();
+		N_individuals = (size_population < 2) ? 2 : size_population;
+
+		n_threads = sample.settings.n_threads;
+		n_elite = 1;
+		size_tournament = 3;
+		probability_crossover = 0.5;
+		speed_mutation = speed;
+		mode_mutation = "random";
+		generation = 0;
+
+		for (size_t i = 0; i < network.layers.size(); ++i)
+			for (size_t j = 0; j < network.layers[i]->get_N_n(); ++j)
+				size_rows.push_back(network.layers[i]->get_N_w() + 1);
+
+		pool.resize(N_individuals * N_weights);
+		new_pool.resize(N_individuals * N_weights);
+		fitness.assign(N_individuals, numeric_limits<double>::lowest()); //not evaluated yet
+
+		network.get_weights(pool.data());
+		for (size_t k = 1; k < N_individuals; ++k)
+		{
+			copy(pool.cbegin(), pool.cbegin() + N_weights, pool.begin() + k * N_weights);
+			mutation(&pool[k * N_weights]);
+		}
+	}
+
+	//fitness of each individual: minus the mean error on data (as in neural_network::testing)
+	//the pairs (individual, part of data) are distributed between threads, each thread has its own copy of the network;
+	//the inputs are packed once into one array and each part is passed to get_out_batch,
+	//the pairs of one thread go one after another, so the weights of an individual are loaded once for its parts
+	void evaluate(const train_data &data)
+	{
+		if (data.size() == 0)
+			return;
+		const size_t N_parts = min(data.size(), max<size_t>(1, (n_threads + N_individuals - 1) / N_individuals));
+		const size_t size_part = (data.size() + N_parts - 1) / N_parts;
+		const size_t N_in = network.get_N_in();
+		const size_t N_out = network.get_N_out();
+		vector <double> error_parts(N_individuals * N_parts, 0.0);
+
+		inputs.resize(data.size() * N_in);
+		for (size_t i = 0; i < data.size(); ++i)
+			copy_n(data[i]->input.cbegin(), N_in, inputs.begin() + i * N_in);
+
+		init_networks();
+		outputs.resize(networks.size());
+#pragma omp parallel num_threads(n_threads)
+		{
+			const size_t thread = omp_get_thread_num();
+			vector <double> &out = outputs[thread];
+			out.resize(size_part * N_out);
+#pragma omp for collapse(2) schedule(static)
+			for (size_t k = 0; k < N_individuals; ++k)
+				for (size_t part = 0; part < N_parts; ++part)
+				{
+					load_individual(thread, k);
+					const size_t begin = part * size_part;
+					const size_t end = min(data.size(), begin + size_part);
+					if (begin >= end)
+						continue;
+					networks[thread].get_out_batch(&inputs[begin * N_in], end - begin, N_in, out.data(), end - begin, N_out);
+					double error = 0.0;
+					for (size_t i = begin; i < end; ++i)
+						for (size_t j = 0; j < N_out; ++j)
+							error += fabs(out[(i - begin) * N_out + j] - data[i]->out[j]);
+					error_parts[k * N_parts + part] = error;
+				}
+		}
+
+		for (size_t k = 0; k < N_individuals; ++k)
+			fitness[k] = -accumulate(error_parts.cbegin() + k * N_parts, error_parts.cbegin() + (k + 1) * N_parts, 0.0) / data.size();
+	}
+
+	//fitness of each individual is calculated by the function (the greater the better), the individuals are distributed between threads
+	void evaluate(const function<double(neural_network&)> &get_fitness)
+	{
+		init_networks();
+#pragma omp parallel num_threads(n_threads)
+		{
+			const size_t thread = omp_get_thread_num();
+#pragma omp for schedule(dynamic)
+			for (size_t k = 0; k < N_individuals; ++k)
+			{
+				load_individual(thread, k);
+				fitness[k] = get_fitness(networks[thread]);
+			}
+		}
+	}
+
+	//the next generation: the best n_elite individuals pass unchanged,
+	//the others are the descendants of the tournament winners after crossover and mutation
+	void next_generation(void)
+	{
+		vector <size_t> order(N_individuals);
+		iota(order.begin(), order.end(), 0);
+		sort(order.begin(), order.end(), [&](const size_t &a, const size_t &b) {return fitness[a] > fitness[b]; });
+
+		const size_t N_elite = min(n_elite, N_individuals);
+		for (size_t k = 0; k < N_elite; ++k)
+			copy(pool.cbegin() + order[k] * N_weights, pool.cbegin() + (order[k] + 1) * N_weights, new_pool.begin() + k * N_weights);
+
+#pragma omp parallel for num_threads(n_threads) schedule(static)
+		for (size_t k = N_elite; k < N_individuals; ++k)
+		{
+			random_generator &gen = get_random_generator();
+			double* const child = &new_pool[k * N_weights];
+			const double* const parent_1 = &pool[tournament(gen) * N_weights];
+
+			if (gen.uniform() < probability_crossover)
+				crossover(child, parent_1, &pool[tournament(gen) * N_weights], gen);
+			else
+				copy(parent_1, parent_1 + N_weights, child);
+			mutation(child);
+		}
+
+		pool.swap(new_pool);
+		vector <double> new_fitness(N_individuals, numeric_limits<double>::lowest());
+		for (size_t k = 0; k < N_elite; ++k)
+			new_fitness[k] = fitness[order[k]];
+		fitness.swap(new_fitness);
+		generation++;
+	}
+
+	//n_generations of evaluation on data and selection, returns the best fitness
+	double run(const train_data &data, const size_t &n_generations)
+	{
+		for (size_t i = 0; i < n_generations; ++i)
+		{
+			evaluate(data);
+			if (i + 1 < n_generations)
+				next_generation();
+		}
+		return get_best_fitness();
+	}
+
+	//the network with the weights of the individual k
+	neural_network get_network(const size_t &k) const
+	{
+		neural_network res(network);
+		res.settings = network.settings;
+		res.set_weights(&pool[k * N_weights]);
+		return res;
+	}
+
+	//the network with the weights of the best individual after the last evaluation
+	neural_network get_best(void) const
+	{
+		return get_network(get_best_index());
+	}
+
+	double get_best_fitness(void) const
+	{
+		return fitness[get_best_index()];
+	}
+
+	//setting the fitness of the individual k when it is calculated outside (for Python)
+	void set_fitness(const size_t &k, const double &value)
+	{
+		fitness[k] = value;
+	}
+
+	vector <double> get_fitness(void) const
+	{
+		return fitness;
+	}
+
+	size_t size(void) const
+	{
+		return N_individuals;
+	}
+
+	size_t get_generation(void) const
+	{
+		return generation;
+	}
+
+	size_t n_threads;
+	size_t n_elite; //the number of the best individuals passing to the next generation unchanged
+	size_t size_tournament;
+	double probability_crossover;
+	double speed_mutation;
+	string mode_mutation; //"random" - as neural_network::random_mutation, "smart" - as neural_network::smart_mutation
+
+private:
+
+	size_t get_best_index(void) const
+	{
+		return distance(fitness.cbegin(), max_element(fitness.cbegin(), fitness.cend()));
+	}
+
+	size_t tournament(random_generator &gen) const
+	{
+		size_t best = gen.uniform_int(N_individuals);
+		for (size_t i = 1; i < size_tournament; ++i)
+		{
+			const size_t k = gen.uniform_int(N_individuals);
+			if (fitness[k] > fitness[best])
+				best = k;
+		}
+		return best;
+	}
+
+	//each neuron of the child is taken entirely from one of the parents
+	void crossover(double* child, const double* parent_1, const double* parent_2, random_generator &gen) const
+	{
+		size_t begin = 0;
+		for (size_t i = 0; i < size_rows.size(); ++i)
+		{
+			const double* const parent = (gen.uniform() < 0.5) ? parent_1 : parent_2;
+			copy(parent + begin, parent + begin + size_rows[i], child + begin);
+			begin += size_rows[i];
+		}
+	}
+
+	void mutation(double* w) const
+	{
+		if (speed_mutation >= 0 && speed_mutation <= 0)
+			return;
+		random_generator &gen = get_random_generator();
+		if (mode_mutation == "smart")
+		{
+			for (size_t i = 0; i < N_weights; ++i)
+				w[i] += gen.uniform(-1.0, 1.0) * fabs(w[i] * speed_mutation);
+		}
+		else
+		{
+			for (size_t i = 0; i < N_weights; ++i)
+				w[i] += gen.uniform(-1.0, 1.0) * speed_mutation;
+		}
+	}
+
+	//copies of the network for threads
+	void init_networks(void)
+	{
+		if (networks.size() < n_threads)
+		{
+			networks.resize(n_threads, network);
+			for (size_t i = 0; i < networks.size(); ++i)
+			{
+				networks[i].settings = network.settings;
+				networks[i].settings.n_threads = 1; //the threads are already divided between the pairs (individual, part)
+			}
+		}
+		loaded.assign(networks.size(), N_individuals);
+	}
+
+	void load_individual(const size_t &thread, const size_t &k)
+	{
+		if (loaded[thread] == k)
+			return;
+		networks[thread].set_weights(&pool[k * N_weights]);
+		loaded[thread] = k;
+	}
+
+	neural_network network; //topology and settings of the population
+	size_t N_weights;
+	size_t N_individuals;
+	size_t generation;
+	vector <size_t> size_rows; //the number of weights of each neuron
+	vector <double> pool;
+	vector <double> new_pool;
+	vector <double> fitness;
+	vector <neural_network> networks;
+	vector <size_t> loaded; //the individual whose weights are in networks[thread]
+	vector <double> inputs; //the inputs of the examples of evaluate one after another
+	vector <vector<double>> outputs; //the outputs of one part for each thread
+};
\ No newline at end of file
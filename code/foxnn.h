@@ -5,6 +5,13 @@
 #include "layer.h"
 #include "train_data.h"
 #include "settings.h"
+#include "test_metrics.h"
+#include "async_testing.h"
+#include "profiler.h"
+#include "tracer.h"
+#include "metrics_sink.h"
+#include "async_sgd.h"
+#include "numa.h"
 
 #include <iostream>
 #include <fstream>
@@ -21,6 +28,13 @@
 #include <ostream>
 #include <memory>
 #include <iomanip>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+#include <limits>
 
 using namespace std;
 
@@ -47,12 +61,63 @@ public:
 		file.close();
 	}
 
-	neural_network(const neural_network &a)
+	neural_network(const neural_network &a) : weights_version(a.get_weights_version())
 	{
 		for (size_t i = 0; i < a.layers.size(); i++)
 			layers.push_back(make_shared<layer> (*(a.layers[i])));
 	}
 
+	//share_weights = true: the layers are shared with a until the first change (copy-on-write),
+	//copying costs O(number of layers) and the memory is spent only on the changed layers
+	neural_network(const neural_network &a, const bool &share_weights) : weights_version(a.get_weights_version())
+	{
+		settings = a.settings;
+		if (share_weights == true)
+			layers = a.layers;
+		else
+			for (size_t i = 0; i < a.layers.size(); i++)
+				layers.push_back(make_shared<layer>(*(a.layers[i])));
+	}
+
+	//move constructor
+	neural_network(neural_network &&a) noexcept : settings(a.settings), testing_callback(move(a.testing_callback)), 
+		progress_callback(move(a.progress_callback)), weights_version(a.get_weights_version()), layers(move(a.layers)), workspaces(move(a.workspaces)),
+		testing_history(move(a.testing_history)), sinks(move(a.sinks)) {}
+
+	//copy-on-write copy of the network
+	neural_network clone() const
+	{
+		return neural_network(*this, true);
+	}
+
+	//the layers are shared with a until the first change (copy-on-write)
+	neural_network& operator= (const neural_network &a)
+	{
+		if (this != &a)
+		{
+			settings = a.settings;
+			layers = a.layers;
+			weights_version.store(a.get_weights_version());
+		}
+		return *this;
+	}
+
+	neural_network& operator= (neural_network &&a) noexcept
+	{
+		if (this != &a)
+		{
+			settings = a.settings;
+			testing_callback = move(a.testing_callback);
+			progress_callback = move(a.progress_callback);
+			sinks = move(a.sinks);
+			layers = move(a.layers);
+			weights_version.store(a.get_weights_version());
+			workspaces = move(a.workspaces);
+			testing_history = move(a.testing_history);
+		}
+		return *this;
+	}
+
 	//the basic method of creating a network
 	neural_network(const vector<int> &parameters)
 	{
@@ -72,6 +137,7 @@ public:
 	void next_layer(const layer &new_layer)
 	{
 		layers.push_back(make_shared<layer>(new_layer));
+		weights_version.store(new_weights_version());
 		return;
 	}
 
@@ -93,11 +159,86 @@ public:
 		return  out;
 	}
 
+	//to give the value of the network into out, enter - buffer for intermediate values
+	//the buffers keep their memory, so repeated calls do not allocate
+	void get_out(const vector<double> &first_in, vector<double> &out, vector<double> &enter) const
+	{
+		get_out(first_in.data(), out, enter);
+	}
+
+	//the same for first_in of get_N_in() values read in place (a row of an array)
+	void get_out(const double* first_in, vector<double> &out, vector<double> &enter) const
+	{
+		layers[0]->get_out(first_in, out);
+
+		for (size_t i = 1; i < layers.size(); ++i)
+		{
+			enter.swap(out);
+			layers[i]->get_out(enter, out, settings.correct_summation);
+		}
+		correction_out(out);
+	}
+
 	vector<double> get_out(const one_train_data &first_in) const
 	{
 		return get_out(first_in.input);
 	}
 
+	//the outputs of N_rows_in inputs written into the preallocated array (for NumPy arrays in Python),
+	//in - N_rows_in x N_cols_in inputs one after another, out - N_rows_out x N_cols_out outputs
+	bool get_out_batch(const double* in, size_t N_rows_in, size_t N_cols_in, double* out, size_t N_rows_out, size_t N_cols_out) const
+	{
+		if (layers.size() == 0 || N_cols_in != layers[0]->get_N_w() || N_cols_out != layers.back()->get_N_n() || N_rows_in != N_rows_out)
+		{
+			cout << "the sizes of the arrays do not match the network" << endl;
+			return false;
+		}
+		if (settings.correct_summation == false && settings.batched_inference == true)
+		{
+			//layer by layer for the whole batch, the weights are read once for several examples
+			vector <double> buffer_1, buffer_2;
+			const double* enter = in;
+			for (size_t i = 0; i < layers.size(); ++i)
+			{
+				double* res = out;
+				if (i + 1 != layers.size())
+				{
+					vector <double> &buffer = (i % 2 == 0) ? buffer_1 : buffer_2;
+					buffer.resize(N_rows_in * layers[i]->get_N_n());
+					res = buffer.data();
+				}
+				layers[i]->get_out_batch(enter, N_rows_in, res, settings.n_threads, settings.min_parallel_work);
+				enter = res;
+			}
+			for (size_t i = 0; i < N_rows_out; ++i)
+				correction_out(out + i * N_cols_out, N_cols_out, settings);
+			return true;
+		}
+		//example by example, the rows are read in place
+#pragma omp parallel num_threads(settings.n_threads) if(N_rows_in * get_N_weights() > settings.min_parallel_work)
+		{
+			vector <double> res;
+			vector <double> enter;
+#pragma omp for
+			for (long long i = 0; i < static_cast<long long>(N_rows_in); ++i)
+			{
+				get_out(in + i * N_cols_in, res, enter);
+				copy(res.cbegin(), res.cend(), out + i * N_cols_out);
+			}
+		}
+		return true;
+	}
+
+	size_t get_N_in() const
+	{
+		return (layers.size() == 0) ? 0 : layers[0]->get_N_w();
+	}
+
+	size_t get_N_out() const
+	{
+		return (layers.size() == 0) ? 0 : layers.back()->get_N_n();
+	}
+
 	void train_on_file(const string &name_file, const double &speed, const size_t &max_iteration, const size_t & size_train_batch = 1)
 	{
 		train_data test(name_file);
@@ -108,6 +249,8 @@ public:
 	{	
 		double start_time;
 		const size_t size_batch = get_batch_size(data_for_train.size(), size_train_batch);
+		make_layers_unique();
+		const pinned_threads pinned(settings.n_threads, settings.pinning); //until the end of training
 		init_memory_for_train(size_batch);
 
 		const size_t size_test = data_for_train.size() * settings.part_for_test;
@@ -120,19 +263,263 @@ public:
 			n_data_for_only_train = data_for_train.size();
 		train_data data_for_only_train = data_for_train.get_first_n(n_data_for_only_train);
 
+		testing_history.clear();
+		init_early_stopping(size_test);
+		neural_network snapshot; //copy of the weights for async_testing
+		async_testing background;
+		if (settings.async_testing == true && settings.n_print != 0 && size_test != 0)
+		{
+			snapshot = neural_network(*this, false);
+			snapshot.settings.n_threads = max<size_t>(settings.n_threads_testing, 1);
+		}
 
-		for (size_t iteration = 1; iteration <= max_iteration; ++iteration)
+		bool stop = false;
+		size_t last_iteration = 0;
+		time_start_train = omp_get_wtime();
+		max_iteration_train = max_iteration;
+		for (size_t iteration = 1; iteration <= max_iteration && stop == false; ++iteration)
 		{
+			last_iteration = iteration;
 			start_train_progressbar(iteration, max_iteration, start_time);
+			const double time_iteration = (sinks.size() != 0) ? omp_get_wtime() : 0.0;
+			double time_stage = end_stage(nullptr, nullptr, 0.0);
 			train_data batch(data_for_only_train.get_part(size_batch));
+			time_stage = end_stage("sampling", &prof.info.time_sampling, time_stage);
 
 			train_nn(batch, speed);
+			time_stage = end_stage("train_nn", &prof.info.time_train, time_stage);
+			if (sinks.size() != 0)
+				record_iteration(iteration, batch, speed, omp_get_wtime() - time_iteration);
 			
-			print_info_iteration(iteration, max_iteration, size_test, test, start_time);
-			auto_save(iteration);
+			//the stages of testing and saving are recorded only at the iterations where they are done
+			bool tested = false;
+			stop = print_info_iteration(iteration, max_iteration, size_test, test, start_time, snapshot, background, tested);
+			time_stage = (tested == true) ? end_stage("testing", &prof.info.time_testing, time_stage) : end_stage(nullptr, nullptr, time_stage);
+			if (auto_save(iteration) == true)
+				end_stage("auto_save", &prof.info.time_save, time_stage);
+			if (progress_callback && progress_callback(iteration, max_iteration) == true)
+				stop = true;
 		}
 
+		if (settings.async_testing == true)
+		{
+			background.wait();
+			take_async_result(background, snapshot);
+			//the last iteration was skipped if the thread of testing was busy, the final weights are tested here
+			if (settings.n_print != 0 && size_test != 0 && (testing_history.size() == 0 || testing_history.back().iteration != last_iteration))
+				test_iteration(test, last_iteration);
+		}
+		finish_early_stopping();
 		delete_memory_after_train();
+
+		training_record r("finish");
+		write_record(r);
+		for (size_t i = 0; i < sinks.size(); ++i)
+			sinks[i]->flush();
+	}
+
+	//asynchronous training without locks (Hogwild): each thread takes its own mini-batches of size_train_batch examples
+	//and adds its gradient to the shared weights without waiting for the other threads;
+	//max_iteration - the number of mini-batches of all threads, max_staleness > 0 - a thread is at most max_staleness
+	//mini-batches ahead of the slowest one, 0 - no bound; SGD and Nesterov (the momentum is kept by each thread), Adam is replaced by SGD
+	async_sgd_info train_async(train_data &data_for_train, const double &speed, const size_t &max_iteration, const size_t &size_train_batch = 1,
+		const size_t &max_staleness = 0)
+	{
+		async_sgd_info info;
+		if (layers.size() == 0 || data_for_train.size() == 0)
+		{
+			cout << "no layers or no data for training" << endl;
+			return info;
+		}
+		make_layers_unique();
+
+		const size_t size_test = data_for_train.size() * settings.part_for_test;
+		const train_data test = data_for_train.get_part_for_test(size_test);
+		size_t n_data_for_only_train = data_for_train.size() * (1 - settings.part_for_test);
+		if (n_data_for_only_train == 0)
+			n_data_for_only_train = data_for_train.size();
+		const train_data data = data_for_train.get_first_n(n_data_for_only_train);
+		const size_t size_batch = get_batch_size(data.size(), size_train_batch);
+
+		const bool nesterov = (settings.settings_optimization.mode == "Nesterov");
+		if (settings.settings_optimization.mode == "Adam")
+			cout << "Adam is not supported by the asynchronous training, SGD is used" << endl;
+		const double gamma = settings.settings_optimization.nesterov.get_gamma();
+		const size_t n_threads = max<size_t>(settings.n_threads, 1);
+
+		//with pinning on several nodes each thread samples from the copy of its part of the data in the memory of its node
+		const numa_topology &topology = numa_topology::get();
+		const pinned_threads pinned(n_threads, settings.pinning);
+		vector <train_data> shards;
+		if (settings.pinning != "none" && topology.get_n_nodes() > 1 && data.size() >= topology.get_n_nodes())
+			shards = split_by_nodes(data);
+
+		//the weights of the layer i are gradient[offsets[i]..offsets[i + 1])
+		vector <size_t> offsets(layers.size() + 1, 0);
+		size_t size_workspace = layers.back()->get_N_n();
+		for (size_t i = 0; i < layers.size(); ++i)
+		{
+			offsets[i + 1] = offsets[i] + layers[i]->get_N_weights();
+			size_workspace += layers[i]->get_size_workspace(settings.correct_summation);
+		}
+		const size_t n_periods = min<size_t>(100, max(max_iteration, static_cast<size_t>(1)));
+
+		struct thread_progress
+		{
+			atomic <size_t> n_steps; //numeric_limits<size_t>::max() - the thread has finished
+			char padding[64]; //the counters of different threads do not share a cache line
+		};
+		vector <thread_progress> progress(n_threads);
+		for (size_t i = 0; i < n_threads; ++i)
+			progress[i].n_steps.store(0);
+		atomic <size_t> next_step(0); //the mini-batches are given out to the threads in turn
+		atomic <size_t> n_updates(0);
+		vector <double> loss_sum(n_periods, 0.0);
+		vector <size_t> loss_count(n_periods, 0);
+		double observed_updates_sum = 0.0;
+
+		time_start_train = omp_get_wtime();
+		max_iteration_train = max_iteration;
+		vector <shared_ptr<layer>>& layers2 = layers;
+#pragma omp parallel num_threads(n_threads) shared(layers2, progress, next_step, n_updates, loss_sum, loss_count, observed_updates_sum, info, shards)
+		{
+			//all memory of the thread is created and first touched by the thread itself
+			const size_t thread = omp_get_thread_num();
+			const train_data &local_data = (shards.size() == 0) ? data :
+				shards[topology.get_node_of_cpu(topology.get_cpu_for_thread(thread, settings.pinning))];
+			random_generator &generator = get_random_generator();
+			workspace memory;
+			memory.reserve(size_workspace);
+			vector <double> gradient(offsets.back());
+			vector <double> velocity((nesterov == true) ? offsets.back() : 0);
+			vector <vector<double>> output(layers2.size());
+			vector <double> local_loss(n_periods, 0.0);
+			vector <size_t> local_count(n_periods, 0);
+			double local_observed_updates = 0.0;
+			size_t local_max_observed_updates = 0;
+			size_t local_max_lead = 0;
+			double local_waiting = 0.0;
+
+			while (true)
+			{
+				const size_t step = next_step.fetch_add(1);
+				if (step >= max_iteration)
+					break;
+
+				if (max_staleness != 0)
+				{
+					const double time_wait = omp_get_wtime();
+					while (true)
+					{
+						size_t slowest = numeric_limits<size_t>::max();
+						for (size_t i = 0; i < n_threads; ++i)
+							slowest = min(slowest, progress[i].n_steps.load(memory_order_relaxed));
+						const size_t done = progress[thread].n_steps.load(memory_order_relaxed);
+						if (done <= slowest + max_staleness)
+						{
+							local_max_lead = max(local_max_lead, done - min(done, slowest));
+							break;
+						}
+						this_thread::yield();
+					}
+					local_waiting += omp_get_wtime() - time_wait;
+				}
+
+				const double time_step = omp_get_wtime();
+				const size_t updates_read = n_updates.load();
+				fill(gradient.begin(), gradient.end(), 0.0);
+				double loss = 0.0;
+				for (size_t b = 0; b < size_batch; ++b)
+				{
+					const one_train_data &sample = *local_data[generator.uniform_int(local_data.size())];
+					layers2[0]->get_out(sample.input, output[0], settings.correct_summation);
+					for (size_t i = 1; i < layers2.size(); ++i)
+						layers2[i]->get_out(output[i - 1], output[i], settings.correct_summation);
+					correction_out(output.back());
+
+					memory.reset();
+					const size_t N_out = sample.out.size();
+					double* error = memory.get(N_out);
+					for (size_t j = 0; j < N_out; ++j)
+					{
+						error[j] = output.back()[j] - sample.out[j];
+						loss += fabs(error[j]);
+					}
+					for (size_t j = layers2.size(); j-- > 0;)
+						error = layers2[j]->back_running_local(error, (j == 0) ? sample.input : output[j - 1], settings, memory, gradient.data() + offsets[j]);
+				}
+
+				for (size_t j = 0; j < layers2.size(); ++j)
+					layers2[j]->add_gradient_async(gradient.data() + offsets[j], speed, (nesterov == true) ? velocity.data() + offsets[j] : nullptr, gamma);
+				weights_version.store(new_weights_version(), memory_order_release);
+				const size_t observed_updates = n_updates.fetch_add(1) - updates_read;
+				progress[thread].n_steps.fetch_add(1, memory_order_relaxed);
+				local_observed_updates += observed_updates;
+				local_max_observed_updates = max(local_max_observed_updates, observed_updates);
+
+				loss /= size_batch;
+				const size_t period = step * n_periods / max_iteration;
+				local_loss[period] += loss;
+				local_count[period]++;
+				if (sinks.size() != 0)
+				{
+					const double time = omp_get_wtime() - time_step;
+					training_record r("iteration");
+					r.iteration = step + 1;
+					r.size_batch = size_batch;
+					r.speed = speed;
+					r.time = time;
+					r.samples_per_second = (time > 0.0) ? size_batch / time : 0.0;
+					r.loss = loss;
+#pragma omp critical(foxnn_async_sgd)
+					write_record(r);
+				}
+				if (thread == 0 && progress_callback && progress_callback(n_updates.load(), max_iteration) == true)
+					next_step.store(max_iteration);
+			}
+			progress[thread].n_steps.store(numeric_limits<size_t>::max());
+
+#pragma omp critical(foxnn_async_sgd)
+			{
+				for (size_t k = 0; k < n_periods; ++k)
+				{
+					loss_sum[k] += local_loss[k];
+					loss_count[k] += local_count[k];
+				}
+				observed_updates_sum += local_observed_updates;
+				info.max_observed_updates = max(info.max_observed_updates, local_max_observed_updates);
+				info.max_lead = max(info.max_lead, local_max_lead);
+				info.time_waiting += local_waiting;
+			}
+		}
+
+		info.time = omp_get_wtime() - time_start_train;
+		info.n_threads = n_threads;
+		info.n_steps = n_updates.load();
+		info.n_samples = info.n_steps * size_batch;
+		info.samples_per_second = (info.time > 0.0) ? info.n_samples / info.time : 0.0;
+		info.mean_observed_updates = (info.n_steps == 0) ? 0.0 : observed_updates_sum / info.n_steps;
+		size_t n_loss = 0;
+		for (size_t k = 0; k < n_periods; ++k)
+			if (loss_count[k] != 0)
+			{
+				info.loss_history.push_back(loss_sum[k] / loss_count[k]);
+				if (k * 10 >= n_periods * 9)
+				{
+					info.loss += loss_sum[k];
+					n_loss += loss_count[k];
+				}
+			}
+		if (n_loss != 0)
+			info.loss /= n_loss;
+		if (size_test != 0)
+			info.metrics = get_metrics(test);
+
+		training_record r("finish");
+		write_record(r);
+		for (size_t i = 0; i < sinks.size(); ++i)
+			sinks[i]->flush();
+		return info;
 	}
 
 	void save(const string &name_file,  const bool &only_scale = false) const
@@ -151,8 +538,79 @@ public:
 		return;
 	}
 
+	//get the number of all weights of the network
+	size_t get_N_weights(void) const
+	{
+		size_t N_weights = 0;
+		for (size_t i = 0; i < layers.size(); ++i)
+			N_weights += layers[i]->get_N_weights();
+		return N_weights;
+	}
+
+	//copying all weights into res[0..get_N_weights()) layer by layer
+	void get_weights(double* res) const
+	{
+		for (size_t i = 0; i < layers.size(); ++i)
+		{
+			layers[i]->get_weights(res);
+			res += layers[i]->get_N_weights();
+		}
+	}
+
+	vector<double> get_weights(void) const
+	{
+		vector<double> res(get_N_weights());
+		get_weights(res.data());
+		return res;
+	}
+
+	//setting all weights from new_w[0..get_N_weights()) layer by layer
+	void set_weights(const double* new_w)
+	{
+		make_layers_unique();
+		for (size_t i = 0; i < layers.size(); ++i)
+		{
+			layers[i]->set_weights(new_w);
+			new_w += layers[i]->get_N_weights();
+		}
+	}
+
+	//the weights are kept by neurons, so an array gets a copy of them (for NumPy arrays in Python)
+	bool get_weights_array(double* out, size_t N_out) const
+	{
+		if (N_out != get_N_weights())
+		{
+			cout << "the number of weights does not match the network" << endl;
+			return false;
+		}
+		get_weights(out);
+		return true;
+	}
+
+	bool set_weights_array(const double* in, size_t N_in)
+	{
+		if (N_in != get_N_weights())
+		{
+			cout << "the number of weights does not match the network" << endl;
+			return false;
+		}
+		set_weights(in);
+		return true;
+	}
+
+	void set_weights(const vector<double> &new_w)
+	{
+		if (new_w.size() != get_N_weights())
+		{
+			cout << "the number of weights does not match the network" << endl;
+			return;
+		}
+		set_weights(new_w.data());
+	}
+
 	void random_mutation(const double &speed)
 	{
+		make_layers_unique();
 #pragma omp parallel for  num_threads(settings.n_threads)
 		for (size_t i = 0; i < layers.size(); ++i)
 			layers[i]->random_mutation(speed);
@@ -160,11 +618,20 @@ public:
 
 	void smart_mutation(const double &speed)
 	{
+		make_layers_unique();
 #pragma omp parallel for  num_threads(settings.n_threads)
 		for (size_t i = 0; i < layers.size(); ++i)
 			layers[i]->smart_mutation(speed);
 	}
 
+	//filling the weights of all layers with random values: "uniform", "xavier" or "he"
+	void init_weights(const string &name = "uniform")
+	{
+		make_layers_unique();
+		for (size_t i = 0; i < layers.size(); ++i)
+			layers[i]->init_weights(name);
+	}
+
 	void print_info(void)
 	{
 		for (size_t i = 0; i < layers.size(); ++i)
@@ -175,54 +642,420 @@ public:
 
 	double testing(const train_data& test) const
 	{
-		size_t n_true;
-		const double er = get_error_for_test(test, n_true);
-		cout << "error = " << scientific << setprecision(15) << er << " n_true = " << n_true << "/" << test.size() << endl;
-		return er;
+		const test_metrics res = get_metrics_for_test(test, true);
+		res.print();
+		return res.error;
+	}
+
+	//testing without output to the console
+	test_metrics get_metrics(const train_data& test) const
+	{
+		return get_metrics_for_test(test, false);
 	}
 
 	layer& operator[] (const size_t &i)
 	{
+		make_layer_unique(i);
 		return *(layers[i]);
 	}
 
 	layer& get_layer (const size_t& i) //for Python
 	{
+		make_layer_unique(i);
 		return *(layers[i]);
 	}
 
+	//the result of profiling of training with settings.profiling = 1, summed over all calls of train since reset_profile
+	profile_info get_profile()
+	{
+		profile_info res = prof.get();
+		res.n_allocations = 0;
+		for (size_t i = 0; i < workspaces.size(); ++i)
+			res.n_allocations += workspaces[i].n_allocations;
+		return res;
+	}
+
+	void reset_profile()
+	{
+		prof.reset();
+		for (size_t i = 0; i < workspaces.size(); ++i)
+			workspaces[i].n_allocations = 0;
+	}
+
+	//the heap memory of the network by categories, the layers shared with copies (copy-on-write) are counted in full
+	memory_usage memory_report() const
+	{
+		memory_usage res;
+		add_memory_weights(res, "");
+		for (size_t i = 0; i < workspaces.size(); ++i)
+			res.add("workspaces", workspaces[i].capacity() * sizeof(double));
+		res.add_vector("workspaces", workspaces);
+		res.add_vector("testing_history", testing_history);
+		return res;
+	}
+
+	//the estimate of the peak heap memory of train on size_data examples with batches of size_train_batch,
+	//called outside of train, the memory of the examples themselves is not included (see train_data::memory_report)
+	memory_usage predict_train_memory(const size_t &size_data, const size_t &size_train_batch) const
+	{
+		memory_usage res = memory_report();
+		const size_t size_batch = get_batch_size(size_data, size_train_batch);
+		const size_t size_test = size_data * settings.part_for_test;
+
+		//the state of the optimizer of each weight
+		const size_t size_optimizer = get_optimization(settings.settings_optimization.mode)->get_size();
+		for (size_t i = 0; i < layers.size(); ++i)
+			for (size_t j = 0; j < layers[i]->neurons.size(); ++j)
+			{
+				const size_t N_w = layers[i]->neurons[j]->get_N() + 1;
+				res.add("optimizer", N_w * sizeof(shared_ptr<base_class_optimization>));
+				res.add_shared("optimizer", size_optimizer, N_w);
+			}
+
+		//the outputs of the layers for each example of the batch
+		size_t size_workspace = (layers.size() == 0) ? 0 : layers.back()->get_N_n();
+		for (size_t i = 0; i < layers.size(); ++i)
+		{
+			res.add("activations", size_batch * sizeof(vector<double>));
+			res.add("activations", layers[i]->get_N_n() * sizeof(double), size_batch);
+			size_workspace += layers[i]->get_size_workspace(settings.correct_summation);
+		}
+
+		//the workspaces which do not exist yet or are too small
+		for (size_t i = 0; i < settings.n_threads; ++i)
+			if (i >= workspaces.size() || workspaces[i].capacity() < size_workspace)
+				res.add("workspaces", size_workspace * sizeof(double));
+
+		//the test part, the train part and the batch are copies of the pointers to the examples
+		res.add("data_index", size_test * sizeof(shared_ptr<one_train_data>));
+		res.add("data_index", (size_data - size_test) * sizeof(shared_ptr<one_train_data>));
+		res.add("data_index", size_batch * sizeof(shared_ptr<one_train_data>));
+
+		if (settings.async_testing == true && settings.n_print != 0 && size_test != 0)
+			add_memory_weights(res, "snapshot");
+		if (settings.early_stopping_patience != 0 && settings.n_print != 0 && size_test != 0)
+			add_memory_weights(res, "best_weights");
+		return res;
+	}
+
+	//saving the timeline of training with settings.tracing = 1 in the Chrome trace format
+	bool save_trace(const string &name_file) const
+	{
+		return trace.save(name_file);
+	}
+
+	void clear_trace()
+	{
+		trace.clear();
+	}
+
+	//the results of testing during the last call of train
+	const vector<test_metrics>& get_testing_history() const
+	{
+		return testing_history;
+	}
+
+	//the iteration with the least testing error during the last call of train with early stopping, 0 - none
+	size_t get_best_iteration() const
+	{
+		return best_iteration;
+	}
+
+	double get_best_error() const
+	{
+		return best_error;
+	}
+
 	Settings settings;
 
+	//called by the training thread with the result of each testing during training, returns true to stop training
+	function<bool(const test_metrics&)> testing_callback;
+
+	//called by the training thread after each iteration with (iteration, max_iteration), returns true to cancel training
+	function<bool(const size_t&, const size_t&)> progress_callback;
+
+	//the records of training (loss, testing, throughput) are given to all sinks, see metrics_sink.h
+	void add_sink(const shared_ptr<metrics_sink> &sink)
+	{
+		if (sink != nullptr)
+			sinks.push_back(sink);
+	}
+
+	void clear_sinks()
+	{
+		sinks.clear();
+	}
+
+	//changes with any change of the weights (training, mutation, set_weights, access to a layer), copies with the same weights
+	//have the same version and the versions of different weights are never equal, so results may be cached by the version
+	size_t get_weights_version() const
+	{
+		return weights_version.load(memory_order_acquire);
+	}
+
+	friend class evolution;
+	friend class ensemble;
+	friend class online_session;
+	friend class shm_trainer;
+	friend class autotuner;
+
 private:
 
+	//a layer shared with other copies of the network is copied before the change
+	//the layer is going to be changed, so the version of the weights is changed too
+	void make_layer_unique(const size_t &i)
+	{
+		if (layers[i].use_count() > 1)
+			layers[i] = make_shared<layer>(*(layers[i]));
+		weights_version.store(new_weights_version(), memory_order_release);
+	}
+
+	static size_t new_weights_version()
+	{
+		static atomic <size_t> last_version(0);
+		return last_version.fetch_add(1) + 1;
+	}
+
+	void make_layers_unique()
+	{
+		for (size_t i = 0; i < layers.size(); ++i)
+			make_layer_unique(i);
+	}
+
+	//the memory for training of online_session, it is kept until delete_memory_after_train
+	void init_online_train(const size_t &size_batch)
+	{
+		make_layers_unique();
+		init_memory_for_train(size_batch);
+		settings.settings_optimization.adam.step = 0;
+	}
+
+	//a layer shared with a copy made during online training gets its own memory for training, the state of the optimizer is lost
+	void make_layer_unique_for_train(const size_t &i, const size_t &size_batch)
+	{
+		if (layers[i].use_count() > 1)
+		{
+			make_layer_unique(i);
+			layers[i]->init_memory_for_train(size_batch, settings);
+		}
+	}
+
+	//the layers, the neurons and the weights, category != "" - everything is counted in the given category
+	void add_memory_weights(memory_usage &report, const string &category) const
+	{
+		report.add_vector((category == "") ? "layers" : category, layers);
+		report.add_shared((category == "") ? "layers" : category, sizeof(layer), layers.size());
+		for (size_t i = 0; i < layers.size(); ++i)
+			layers[i]->add_memory(report, category);
+	}
+
 	void delete_memory_after_train()
 	{
 		for (auto i : layers)
 			i->delete_memory_after_train();
 	}
 
-	void auto_save(const size_t &iteration) const
+	//returns true if the network was saved at this iteration
+	bool auto_save(const size_t &iteration) const
 	{
-		if (settings.auto_save_iteration != 0)
-			if (iteration % settings.auto_save_iteration == 0)
-				save(settings.auto_save_name_file);
+		if (settings.auto_save_iteration == 0 || iteration % settings.auto_save_iteration != 0)
+			return false;
+		save(settings.auto_save_name_file);
+		return true;
 	}
 
-	void print_info_iteration(const size_t &iteration, const size_t &max_iteration, const size_t &size_test, const train_data &test, const double &start_time) const
+	//returns true if training must be stopped, tested - this iteration is a point of testing
+	bool print_info_iteration(const size_t &iteration, const size_t &max_iteration, const size_t &size_test, const train_data &test, const double &start_time,
+		neural_network &snapshot, async_testing &background, bool &tested)
 	{
 		train_progressbar(iteration, max_iteration, start_time);
 
-		if (settings.n_print != 0 && size_test != 0)
-			if (iteration == max_iteration || (iteration % settings.n_print == 0))
-			{
-				testing(test);
-				cout << "iteration = " << iteration << endl << endl;
-			}
+		tested = false;
+		if (settings.n_print == 0 || size_test == 0)
+			return false;
+		if (iteration != max_iteration && (iteration % settings.n_print != 0))
+			return false;
+		tested = true;
+
+		if (settings.async_testing == false)
+			return test_iteration(test, iteration);
+
+		//the result of the previous testing is printed, and the copy of the current weights is tested if the thread is free
+		const bool stop = take_async_result(background, snapshot);
+		if (background.is_busy() == false)
+		{
+			snapshot.copy_weights(*this);
+			background.start([&snapshot, &test, iteration]()
+				{
+					test_metrics res = snapshot.get_metrics(test);
+					res.iteration = iteration;
+					return res;
+				});
+		}
+		return stop;
+	}
+
+	//testing the current weights in the training thread, returns true if training must be stopped
+	bool test_iteration(const train_data &test, const size_t &iteration)
+	{
+		test_metrics res = get_metrics_for_test(test, settings.print_progress);
+		res.iteration = iteration;
+		if (settings.print_progress == true)
+		{
+			res.print();
+			cout << "iteration = " << iteration << endl << endl;
+		}
+		return add_testing_result(res, *this);
+	}
+
+	//printing the finished result of async_testing, returns true if training must be stopped
+	bool take_async_result(async_testing &background, const neural_network &snapshot)
+	{
+		test_metrics res;
+		if (background.get_result(res) == false)
+			return false;
+		if (settings.print_progress == true)
+		{
+			res.print();
+			cout << "iteration = " << res.iteration << " time_test = " << fixed << setprecision(3) << res.time << endl << endl;
+		}
+		return add_testing_result(res, snapshot);
+	}
+
+	//tested - the network with the tested weights, returns true if training must be stopped
+	bool add_testing_result(const test_metrics &res, const neural_network &tested)
+	{
+		testing_history.push_back(res);
+		if (sinks.size() != 0)
+		{
+			training_record r("testing");
+			r.iteration = res.iteration;
+			r.metrics = res;
+			write_record(r);
+		}
+		bool stop = check_early_stopping(res, tested);
+		if (testing_callback)
+			stop = testing_callback(res) || stop;
+		return stop;
+	}
+
+	//the error is checked only at the points of testing, so without them (n_print = 0 or no test part) early stopping is off
+	void init_early_stopping(const size_t &size_test)
+	{
+		best_iteration = 0;
+		best_error = numeric_limits<double>::max();
+		n_without_improvement = 0;
+		early_stopping = (settings.early_stopping_patience != 0 && settings.n_print != 0 && size_test != 0);
+		if (settings.early_stopping_patience != 0 && early_stopping == false)
+			cout << "early stopping is off: there is no testing during training (n_print = 0 or part_for_test = 0)" << endl;
+		if (early_stopping == true && best_network == nullptr)
+			best_network = make_shared<neural_network>(*this, false);
+	}
+
+	//the best weights are copied without allocations, returns true if there has been no improvement patience times in a row
+	bool check_early_stopping(const test_metrics &res, const neural_network &tested)
+	{
+		if (early_stopping == false)
+			return false;
+		if (res.error < best_error - settings.early_stopping_min_delta)
+		{
+			best_error = res.error;
+			best_iteration = res.iteration;
+			n_without_improvement = 0;
+			best_network->copy_weights(tested);
+			return false;
+		}
+		n_without_improvement++;
+		if (n_without_improvement < settings.early_stopping_patience)
+			return false;
+		if (settings.print_progress == true)
+			cout << "early stopping: best iteration = " << best_iteration << " error = " << scientific << setprecision(15) << best_error << endl << endl;
+		training_record r("early_stopping");
+		r.iteration = best_iteration;
+		r.metrics.error = best_error;
+		write_record(r);
+		return true;
+	}
+
+	void finish_early_stopping()
+	{
+		if (early_stopping == false || best_iteration == 0)
+		{
+			best_network = nullptr;
+			return;
+		}
+		if (settings.best_save_name_file != "")
+		{
+			best_network->settings = settings;
+			best_network->save(settings.best_save_name_file);
+		}
+		if (settings.restore_best == true)
+			copy_weights(*best_network);
+		best_network = nullptr;
+	}
+
+	//copying the weights of the network a with the same topology without allocations
+	void copy_weights(const neural_network &a)
+	{
+		for (size_t i = 0; i < layers.size(); ++i)
+			layers[i]->copy_weights(*(a.layers[i]));
+		weights_version.store(a.get_weights_version(), memory_order_release);
+	}
+
+	void record_iteration(const size_t &iteration, const train_data &batch, const double &speed, const double &time) const
+	{
+		training_record r("iteration");
+		r.iteration = iteration;
+		r.size_batch = batch.size();
+		r.speed = speed;
+		r.time = time;
+		r.samples_per_second = (time > 0.0) ? batch.size() / time : 0.0;
+		if (batch.size() != 0)
+			r.loss = get_batch_loss(batch) / batch.size();
+		write_record(r);
+	}
+
+	//the sum over the batch of the absolute errors of the outputs, the outputs of the last layer remain after the forward stroke
+	double get_batch_loss(const train_data &batch) const
+	{
+		double res = 0.0;
+		const vector <vector<double>> &output = layers.back()->output;
+		for (size_t i = 0; i < batch.size(); ++i)
+			for (size_t j = 0; j < output[i].size(); ++j)
+				res += fabs(output[i][j] - batch[i]->out[j]);
+		return res;
+	}
+
+	//the derivatives of all weights in the order of get_weights
+	void get_derivatives(double* res) const
+	{
+		for (size_t i = 0; i < layers.size(); ++i)
+		{
+			layers[i]->get_derivatives(res);
+			res += layers[i]->get_N_weights();
+		}
+	}
+
+	void set_derivatives(const double* new_derivatives)
+	{
+		for (size_t i = 0; i < layers.size(); ++i)
+		{
+			layers[i]->set_derivatives(new_derivatives);
+			new_derivatives += layers[i]->get_N_weights();
+		}
+	}
+
+	void write_record(training_record &r) const
+	{
+		r.max_iteration = max_iteration_train;
+		r.elapsed = omp_get_wtime() - time_start_train;
+		for (size_t i = 0; i < sinks.size(); ++i)
+			sinks[i]->write(r);
 	}
 
 	void start_train_progressbar(const size_t &i, const size_t &max_iteration, double &start_time) const
 	{
-		if (settings.n_print == 0)
+		if (settings.n_print == 0 || settings.print_progress == false)
 			return;
 		if ((i - 1) % settings.n_print == 0)
 		{
@@ -253,7 +1086,7 @@ private:
 
 	void train_progressbar(const size_t & i, const size_t & max_iteration, const double& start_time) const
 	{
-		if (settings.n_print == 0)
+		if (settings.n_print == 0 || settings.print_progress == false)
 			return;
 		const size_t i_after_print = i - ((i - 1) / settings.n_print) * settings.n_print;
 
@@ -279,81 +1112,147 @@ private:
 		return 1;
 	}
 
-	double get_error_for_test(const train_data &test, size_t &n_true) const
+	//each thread tests its parts of the sample with its own buffers and sums, the sums are combined once at the end
+	//the progress is counted by an atomic counter, which is printed by a separate thread several times per second
+	test_metrics get_metrics_for_test(const train_data &test, const bool &print_progress) const
 	{
 		const double start_test = omp_get_wtime();
-		double error = 0.0;
-		size_t n_true_answer = 0;
-		cout << "test progressbar: ";
-		start_progressbar(test.size());
-		size_t iteration_done = 0;
-		omp_lock_t lock;
-		omp_init_lock(&lock);
-#pragma omp parallel for  num_threads(settings.n_threads)  reduction (+: error) reduction (+: n_true_answer) shared(test)
-		for (size_t i = 0; i < test.size(); ++i) 
-		{
-			size_t need_max = 0;
-			const vector <double> out = get_out(test[i]->input);
-			for (size_t j = 0; j < out.size(); ++j)
+		const size_t N_out = (test.size() == 0) ? 0 : test[0]->out.size();
+		const size_t size_part = 64;
+		test_metrics res(N_out);
+
+		atomic <size_t> iteration_done(0);
+		bool done = false;
+		mutex mutex_done;
+		condition_variable cv_done;
+		thread reporter;
+		if (print_progress == true)
+		{
+			cout << "test progressbar: ";
+			start_progressbar(test.size());
+			reporter = thread([&]()
+				{
+					unique_lock <mutex> lock(mutex_done);
+					while (cv_done.wait_for(lock, chrono::milliseconds(100), [&]() {return done; }) == false)
+						progressbar(iteration_done.load(memory_order_relaxed), test.size());
+				});
+		}
+
+#pragma omp parallel num_threads(settings.n_threads) shared(test, res)
+		{
+			test_metrics part_res(N_out);
+			vector <double> out;
+			vector <double> enter;
+#pragma omp for schedule(dynamic)
+			for (size_t begin = 0; begin < test.size(); begin += size_part)
 			{
-				const double delta = fabs(out[j] - test[i]->out[j]);
-				error += delta;
-				if (delta < settings.min_error)
-					need_max++;
+				const size_t end = min(begin + size_part, test.size());
+				for (size_t i = begin; i < end; ++i)
+				{
+					get_out(test[i]->input, out, enter);
+					part_res.add(out, test[i]->out, settings.min_error);
+				}
+				iteration_done.fetch_add(end - begin, memory_order_relaxed);
 			}
-			if (need_max == out.size())
-				n_true_answer++;
-			omp_set_lock(&lock);
-			iteration_done++;
-			progressbar(iteration_done, test.size());
-			omp_unset_lock(&lock);
+#pragma omp critical
+			res.merge(part_res);
 		}
-		n_true = n_true_answer;
-		omp_destroy_lock(&lock);
+		res.finish();
+		res.time = omp_get_wtime() - start_test;
 
-		const double time_test = omp_get_wtime() - start_test;
-		cout << " time_test = " << fixed << setprecision(3) << time_test << endl;
-		return error / test.size();
+		if (print_progress == true)
+		{
+			{
+				lock_guard <mutex> lock(mutex_done);
+				done = true;
+			}
+			cv_done.notify_one();
+			reporter.join();
+			progressbar(test.size(), test.size());
+			cout << " time_test = " << fixed << setprecision(3) << res.time << endl;
+		}
+		return res;
 	}
 
-	void error_last_layer(const train_data &batch, vector <vector <double>> &error) const
+	//error of the last layer for the i-th example of the batch
+	double* error_last_layer(const train_data &batch, const size_t &i, workspace &memory) const
 	{
-		error.resize(batch.size());
-		for (size_t i = 0; i < batch.size(); ++i)
-			error[i].resize(batch[i]->out.size());
+		const vector <double> &out = layers.back()->output[i];
+		const size_t N_out = batch[i]->out.size();
+		double* const error = memory.get(N_out);
 
-		for (size_t i = 0; i < batch.size(); ++i)
-			for (size_t j = 0; j < batch[i]->out.size(); ++j)
-				error[i][j] = layers.back()->output[i][j] - batch[i]->out[j];
-		return;
+		for (size_t j = 0; j < N_out; ++j)
+			error[j] = out[j] - batch[i]->out[j];
+		return error;
+	}
+
+	bool is_profiling() const
+	{
+		return profiling_compiled && settings.profiling;
+	}
+
+	bool is_tracing() const
+	{
+		return profiling_compiled && settings.tracing;
+	}
+
+	//the end of the stage of training which began at start: the time is added to the counter of profiling
+	//and to the timeline, returns the current time (0 without profiling and tracing)
+	double end_stage(const char* name, double* counter, const double &start)
+	{
+		if (is_profiling() == false && is_tracing() == false)
+			return 0.0;
+		const double now = omp_get_wtime();
+		if (is_profiling() == true && counter != nullptr)
+			*counter += now - start;
+		if (is_tracing() == true && name != nullptr)
+			trace.add(0, name, -1, start, now);
+		return now;
 	}
 
 	void forward_stroke(const train_data &batch)
 	{
 		vector <shared_ptr<layer>>& layers2 = layers;
+		const bool profiling = is_profiling();
+		const bool tracing = is_tracing();
 #pragma omp parallel for num_threads(settings.n_threads) shared(batch, layers2)
 		for (size_t j = 0; j < batch.size(); ++j)
 		{
-			layers2[0]->get_out(batch[j]->input, layers2[0]->output[j]);
-
-			for (size_t i = 1; i < layers2.size(); ++i)
-				layers2[i]->get_out(layers2[i - 1]->output[j], layers2[i]->output[j]);
+			const double time_sample = (profiling == true || tracing == true) ? omp_get_wtime() : 0.0;
+			double time_start = time_sample;
+			for (size_t i = 0; i < layers2.size(); ++i)
+			{
+				layers2[i]->get_out((i == 0) ? batch[j]->input : layers2[i - 1]->output[j], layers2[i]->output[j]);
+				if (profiling == true)
+				{
+					const double now = omp_get_wtime();
+					prof.add_forward(omp_get_thread_num(), i, now - time_start);
+					time_start = now;
+				}
+			}
 			correction_out(layers2.back()->output[j]);
+			if (tracing == true)
+				trace.add(omp_get_thread_num(), "forward_stroke", j, time_sample, omp_get_wtime());
 		}
 	}
 
 	void correction_out(vector<double> &out) const
+	{
+		correction_out(out.data(), out.size(), settings);
+	}
+
+	static void correction_out(double* out, const size_t &N_out, const Settings &settings)
 	{
 		if (settings.max_on_last_layer == 1)
 		{
-			const size_t max_n = distance(out.begin(), max_element(out.begin(), out.end()));
-			fill(out.begin(), out.end(), 0.0);
+			const size_t max_n = distance(out, max_element(out, out + N_out));
+			fill(out, out + N_out, 0.0);
 			out[max_n] = 1;
 			return;
 		}
 		if (settings.one_if_value_greater_intermediate_value == 1)
 		{
-			for_each(out.begin(), out.end(), [&](double& num)
+			for_each(out, out + N_out, [&](double& num)
 				{
 					if (num >= settings.intermediate_value)
 					{
@@ -373,33 +1272,116 @@ private:
 	{
 		for (size_t i = 0; i < layers.size(); ++i)
 			layers[i]->init_memory_for_train(size_batch, settings);
+
+		//the workspaces are not freed after training and are reused by the next call of train
+		size_t size_workspace = layers.back()->get_N_n();
+		for (size_t i = 0; i < layers.size(); ++i)
+			size_workspace += layers[i]->get_size_workspace(settings.correct_summation);
+
+		if (workspaces.size() < settings.n_threads)
+			workspaces.resize(settings.n_threads);
+		//the workspace of each thread is first touched by the thread itself, so its memory is placed on the node of the thread
+#pragma omp parallel num_threads(settings.n_threads)
+		workspaces[omp_get_thread_num()].reserve(size_workspace);
+		for (size_t i = 0; i < workspaces.size(); ++i)
+			workspaces[i].reserve(size_workspace);
+
+		if (is_profiling() == true)
+		{
+			vector <size_t> N_weights(layers.size());
+			for (size_t i = 0; i < layers.size(); ++i)
+				N_weights[i] = layers[i]->get_N_weights();
+			prof.init(N_weights, settings.n_threads);
+		}
+		if (is_tracing() == true)
+			trace.init(settings.n_threads, settings.size_trace);
 	}
 
 	void train_nn(const train_data & batch, const double &speed)
 	{
+		back_propagation(batch);
+		update_weights(speed, batch.size());
+	}
 
+	//the derivatives of the batch are summed in the state of the optimizer of each weight
+	void back_propagation(const train_data & batch)
+	{
 		forward_stroke(batch);
 
-		vector <vector <double>> error;
 		vector <shared_ptr<layer>>& layers2 = layers;
-		error_last_layer(batch, error);
 
-#pragma omp parallel for  num_threads(settings.n_threads) shared(error, batch, layers2)
-		for (size_t i = 0; i < batch.size(); ++i)
+		const bool profiling = is_profiling();
+		const bool tracing = is_tracing();
+
+#pragma omp parallel num_threads(settings.n_threads) shared(batch, layers2)
 		{
-			for (size_t j = layers2.size() - 1; j >= 1; --j)
-				layers2[j]->back_running(error[i], layers2[j - 1]->output[i], settings.correct_summation);
+			const size_t thread = omp_get_thread_num();
+			workspace &memory = workspaces[thread];
+#pragma omp for
+			for (size_t i = 0; i < batch.size(); ++i)
+			{
+				memory.reset(); //all temporary values of the previous example are no longer needed
+				const double time_sample = (profiling == true || tracing == true) ? omp_get_wtime() : 0.0;
+				double time_start = time_sample;
+				double* error = error_last_layer(batch, i, memory);
 
-			layers2[0]->back_running(error[i], batch[i]->input, settings.correct_summation);
+				for (size_t j = layers2.size(); j-- > 0;)
+				{
+					error = layers2[j]->back_running(error, (j == 0) ? batch[i]->input : layers2[j - 1]->output[i], settings, memory);
+					if (profiling == true)
+					{
+						const double now = omp_get_wtime();
+						prof.add_backward(thread, j, now - time_start);
+						time_start = now;
+					}
+				}
+				if (tracing == true)
+					trace.add(thread, "back_running", i, time_sample, omp_get_wtime());
+			}
 		}
+	}
+
+	void update_weights(const double &speed, const size_t &size_batch)
+	{
+		vector <shared_ptr<layer>>& layers2 = layers;
+		const bool profiling = is_profiling();
+		const bool tracing = is_tracing();
 
 #pragma omp parallel for  num_threads(settings.n_threads) shared(layers2)
 		for (int i = 0; i < layers2.size(); ++i)
+		{
+			const double time_start = (profiling == true || tracing == true) ? omp_get_wtime() : 0.0;
 			layers2[i]->correction_of_scales(speed, settings);
+			if (profiling == true || tracing == true)
+			{
+				const double now = omp_get_wtime();
+				if (profiling == true)
+					prof.add_update(omp_get_thread_num(), i, now - time_start);
+				if (tracing == true)
+					trace.add(omp_get_thread_num(), "correction_of_scales", i, time_start, now);
+			}
+		}
+		weights_version.store(new_weights_version(), memory_order_release);
+
+		if (profiling == true)
+			prof.add_iteration(size_batch);
 
 		settings.settings_optimization.adam.next_step();
 		return;
 	}
 
+	atomic <size_t> weights_version{new_weights_version()};
 	vector <shared_ptr<layer>> layers;
+	vector <workspace> workspaces; //memory for the temporary values of each thread during training
+	vector <test_metrics> testing_history;
+	vector <shared_ptr<metrics_sink>> sinks;
+	double time_start_train = 0.0;
+	size_t max_iteration_train = 0;
+	profiler prof;
+	tracer trace;
+	shared_ptr <neural_network> best_network; //the weights with the least testing error for early stopping
+	double best_error = 0.0;
+	size_t best_iteration = 0;
+	size_t n_without_improvement = 0;
+	bool early_stopping = false; //early_stopping_patience != 0 and there is testing during the current training
 };
\ No newline at end of file
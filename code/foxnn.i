@@ -1,37 +1,182 @@
-%module foxnn
+%module(threads="1") foxnn
 
 %{
 #include "foxnn.h"
 #include "layer.h"
 #include "train_data.h"
 #include "settings.h"
+#include "test_metrics.h"
+#include "profiler.h"
+#include "metrics_sink.h"
+#include "memory_usage.h"
+#include "async_sgd.h"
+#include "evolution.h"
+#include "ensemble.h"
+#include "model_handle.h"
+#include "inference_cache.h"
+#include "online_learning.h"
+#include "numa.h"
+#include "numa_replicas.h"
+#include "autotune.h"
+#include "foxnn_python.h"
 %}
 
+%typemap(in) (const double* in, size_t N_rows_in, size_t N_cols_in), (const double* target, size_t N_rows_target, size_t N_cols_target) (foxnn_buffer buffer)
+{
+	if (buffer.get($input, false) == false)
+		SWIG_fail;
+	$1 = buffer.data;
+	$2 = buffer.rows;
+	$3 = buffer.cols;
+}
+
+%typemap(in) (double* out, size_t N_rows_out, size_t N_cols_out) (foxnn_buffer buffer)
+{
+	if (buffer.get($input, true) == false)
+		SWIG_fail;
+	$1 = buffer.data;
+	$2 = buffer.rows;
+	$3 = buffer.cols;
+}
+
+%typemap(in) (const double* in, size_t N_in) (foxnn_buffer buffer)
+{
+	if (buffer.get($input, false) == false)
+		SWIG_fail;
+	$1 = buffer.data;
+	$2 = buffer.rows * buffer.cols;
+}
+
+%typemap(in) (double* out, size_t N_out) (foxnn_buffer buffer)
+{
+	if (buffer.get($input, true) == false)
+		SWIG_fail;
+	$1 = buffer.data;
+	$2 = buffer.rows * buffer.cols;
+}
+
 %include "std_string.i"
 %include "std_vector.i"
+%include "std_map.i"
+%include "std_shared_ptr.i"
 
 namespace std {
 typedef unsigned int size_t;
 %template(IntVector) vector<int>;
 %template(DoubleVector) vector<double>;
 %template(DoubleVVector) vector<vector<double>>;
+%template(SizeVector) vector<size_t>;
+%template(SizeVVector) vector<vector<size_t>>;
+%template(StringDoubleMap) map<string, double>;
+}
+%include test_metrics.h
+%template(TestMetricsVector) std::vector<test_metrics>;
+%include profiler.h
+%include memory_usage.h
+%extend memory_usage {
+%pythoncode %{
+    def to_dict(self):
+        return dict(self.to_map())
+%}
 }
+%include async_sgd.h
+%template(LayerProfileVector) std::vector<layer_profile>;
+
+%shared_ptr(metrics_sink)
+%shared_ptr(jsonl_sink)
+%shared_ptr(ring_sink)
+%shared_ptr(console_sink)
+%ignore callback_sink;
+%include metrics_sink.h
+%template(TrainingRecordVector) std::vector<training_record>;
+
+//the Python lock is released only by the long calls which do not use Python objects,
+//so other Python threads may run and train other networks at the same time
+%nothread;
+%thread neural_network::train;
+%thread neural_network::train_on_file;
+%thread neural_network::train_async;
+%thread neural_network::testing;
+%thread neural_network::get_metrics;
+%thread neural_network::get_out;
+%thread neural_network::get_out_batch;
+%thread train_data::add_data_array;
+%thread evolution::evaluate;
+%thread evolution::run;
+%thread ensemble::get_out_batch;
+%thread model_handle::get_out;
+%thread model_handle::get_out_batch;
+%thread model_handle::publish;
+%thread model_handle::load;
+%thread model_handle::synchronize;
+%thread inference_cache::get_out;
+%thread online_session::learn;
+%thread online_session::learn_batch;
+%thread online_session::publish;
+%thread numa_replicas::get_out;
+%thread numa_replicas::get_out_batch;
+%thread numa_replicas::update;
+%thread autotuner::tune;
+
+%ignore neural_network::testing_callback;
+%ignore neural_network::progress_callback;
+%ignore neural_network::get_out(const double*, vector<double> &, vector<double> &) const;
 %include foxnn.h
+%extend neural_network {
+	//callable(iteration, max_iteration) is called with the Python lock every n_iterations iterations and after the last one,
+	//a true result cancels training, None removes the callback
+	void set_progress_callback(PyObject* callable, size_t n_iterations = 1)
+	{
+		foxnn_set_progress_callback(*$self, callable, n_iterations);
+	}
+
+%pythoncode %{
+    def get_profile_dict(self):
+        return dict(self.get_profile().to_map())
+
+    def predict(self, x, out=None):
+        """outputs of the rows of the 2D array x, out - the preallocated float64 array for the result"""
+        if out is None:
+            import numpy
+            out = numpy.empty((len(x), self.get_N_out()), dtype=numpy.float64)
+        if not self.get_out_batch(x, out):
+            raise ValueError("the sizes of the arrays do not match the network")
+        return out
+
+    def get_weights_numpy(self):
+        import numpy
+        res = numpy.empty(self.get_N_weights(), dtype=numpy.float64)
+        self.get_weights_array(res)
+        return res
+%}
+}
+%ignore layer::get_out(const double*, vector <double> &, const bool &) const;
 %include layer.h
 %include train_data.h
 %include settings.h
 
+%ignore evolution::evaluate(const function<double(neural_network&)> &);
+%include evolution.h
 
+%ignore ensemble::get_out(const double*, const size_t &, vector<double> &) const;
+%include ensemble.h
 
+%ignore model_handle::reader;
+%ignore model_handle::read;
+%ignore model_handle::load_async;
+%ignore model_handle::publish(neural_network &&);
+%include model_handle.h
 
+%include inference_cache.h
 
+%rename(learn_array) online_session::learn_batch(const double*, size_t, size_t, const double*, size_t, size_t);
+%include online_learning.h
 
+%template(TrainDataVector) std::vector<train_data>;
+%ignore run_on_node;
+%ignore thread_affinity;
+%ignore pinned_threads;
+%include numa.h
+%include numa_replicas.h
 
-
-
-
-
-
-
-
-
+%include autotune.h
@@ -0,0 +1,112 @@
+//Copyright[2019][Gaganov Ilya]
+//Licensed under the Apache License, Version 2.0
+
+#pragma once
+
+//the code of the Python module used by foxnn.i, kept in a header so it is compiled and checked without swig
+//(make check_python_glue); Python.h must be the first header, as in the code generated by swig
+
+#include <Python.h>
+#include "foxnn.h"
+#include <vector>
+#include <string>
+#include <memory>
+
+using namespace std;
+
+//the array of a Python object with the buffer protocol (NumPy, array.array, memoryview) as C-contiguous doubles:
+//float64 is used without copying, float32 inputs are converted into a temporary copy
+class foxnn_buffer
+{
+public:
+	foxnn_buffer() : data(nullptr), rows(0), cols(0), has_view(false) {}
+
+	~foxnn_buffer()
+	{
+		if (has_view == true)
+			PyBuffer_Release(&view);
+	}
+
+	foxnn_buffer(const foxnn_buffer &) = delete;
+	foxnn_buffer& operator= (const foxnn_buffer &) = delete;
+
+	bool get(PyObject* obj, const bool &writable)
+	{
+		const int flags = PyBUF_C_CONTIGUOUS | PyBUF_FORMAT | ((writable == true) ? PyBUF_WRITABLE : 0);
+		if (PyObject_GetBuffer(obj, &view, flags) != 0)
+			return false;
+		has_view = true;
+		if (view.ndim > 2)
+		{
+			PyErr_SetString(PyExc_ValueError, "the array must have 1 or 2 dimensions");
+			return false;
+		}
+		rows = (view.ndim == 2) ? view.shape[0] : 1;
+		cols = (view.ndim == 0) ? 1 : view.shape[view.ndim - 1];
+
+		string format = (view.format == nullptr) ? "B" : view.format;
+		if (format.size() == 2 && (format[0] == '<' || format[0] == '=' || format[0] == '@'))
+			format = format.substr(1);
+		if (format == "d" && view.itemsize == sizeof(double))
+		{
+			data = static_cast<double*>(view.buf);
+			return true;
+		}
+		if (format == "f" && view.itemsize == sizeof(float) && writable == false)
+		{
+			const float* const values = static_cast<const float*>(view.buf);
+			converted.assign(values, values + rows * cols);
+			data = converted.data();
+			return true;
+		}
+		PyErr_SetString(PyExc_TypeError, (writable == true) ? "the output array must be C-contiguous float64" : "the array must be C-contiguous float64 or float32");
+		return false;
+	}
+
+	double* data;
+	size_t rows; //1 for one-dimensional arrays
+	size_t cols;
+
+private:
+	Py_buffer view;
+	vector <double> converted;
+	bool has_view;
+};
+
+//callable(iteration, max_iteration) is called with the Python lock every n_iterations iterations and after the last one,
+//a true result or an exception cancels training, None removes the callback; called with the Python lock
+inline void foxnn_set_progress_callback(neural_network &nn, PyObject* callable, const size_t &n_iterations)
+{
+	if (callable == Py_None)
+	{
+		nn.progress_callback = nullptr;
+		return;
+	}
+	Py_INCREF(callable);
+	const shared_ptr<PyObject> holder(callable, [](PyObject* p)
+		{
+			const PyGILState_STATE state = PyGILState_Ensure();
+			Py_DECREF(p);
+			PyGILState_Release(state);
+		});
+	nn.progress_callback = [holder, n_iterations](const size_t &iteration, const size_t &max_iteration)
+	{
+		if (n_iterations == 0 || (iteration % n_iterations != 0 && iteration != max_iteration))
+			return false;
+		const PyGILState_STATE state = PyGILState_Ensure();
+		PyObject* const res = PyObject_CallFunction(holder.get(), "nn", static_cast<Py_ssize_t>(iteration), static_cast<Py_ssize_t>(max_iteration));
+		int stop = 1; //an exception in the callback or in its truth value stops training
+		if (res != nullptr)
+		{
+			stop = PyObject_IsTrue(res);
+			Py_DECREF(res);
+		}
+		if (stop < 0 || PyErr_Occurred() != nullptr)
+		{
+			PyErr_Print();
+			stop = 1;
+		}
+		PyGILState_Release(state);
+		return stop != 0;
+	};
+}
@@ -0,0 +1,141 @@
+//Copyright[2019][Gaganov Ilya]
+//Licensed under the Apache License, Version 2.0
+
+//the module for foxnn_python_check.py: make check_python_glue (swig is not needed)
+//the functions are wrapped as swig wraps them with foxnn.i: the arrays through foxnn_buffer of the same typemaps,
+//the Python lock is released around the calls marked with %thread, the callback is set by foxnn_set_progress_callback
+
+#include "foxnn_python.h"
+
+static neural_network network;
+
+//the network N_in - N_hidden - N_out used by the other functions
+static PyObject* check_init(PyObject*, PyObject* args)
+{
+	int N_in = 0, N_hidden = 0, N_out = 0;
+	if (!PyArg_ParseTuple(args, "iii", &N_in, &N_hidden, &N_out))
+		return nullptr;
+	network = neural_network(vector<int>{ N_in, N_hidden, N_out });
+	network.settings.print_progress = 0;
+	Py_RETURN_NONE;
+}
+
+//neural_network::get_out_batch(const double* in, size_t N_rows_in, size_t N_cols_in, double* out, size_t N_rows_out, size_t N_cols_out)
+static PyObject* check_get_out_batch(PyObject*, PyObject* args)
+{
+	PyObject* obj_in = nullptr;
+	PyObject* obj_out = nullptr;
+	if (!PyArg_ParseTuple(args, "OO", &obj_in, &obj_out))
+		return nullptr;
+	foxnn_buffer in, out;
+	if (in.get(obj_in, false) == false || out.get(obj_out, true) == false)
+		return nullptr;
+	bool res = false;
+	Py_BEGIN_ALLOW_THREADS
+	res = network.get_out_batch(in.data, in.rows, in.cols, out.data, out.rows, out.cols);
+	Py_END_ALLOW_THREADS
+	return PyBool_FromLong(res);
+}
+
+//neural_network::get_out(const vector<double> &) for the comparison, the input is a sequence of numbers
+static PyObject* check_get_out(PyObject*, PyObject* args)
+{
+	PyObject* obj_in = nullptr;
+	if (!PyArg_ParseTuple(args, "O", &obj_in))
+		return nullptr;
+	PyObject* const sequence = PySequence_Fast(obj_in, "the input must be a sequence");
+	if (sequence == nullptr)
+		return nullptr;
+	vector <double> first_in(PySequence_Fast_GET_SIZE(sequence));
+	for (size_t i = 0; i < first_in.size(); ++i)
+		first_in[i] = PyFloat_AsDouble(PySequence_Fast_GET_ITEM(sequence, i));
+	Py_DECREF(sequence);
+	if (PyErr_Occurred() != nullptr)
+		return nullptr;
+	vector <double> out;
+	Py_BEGIN_ALLOW_THREADS
+	out = network.get_out(first_in);
+	Py_END_ALLOW_THREADS
+	PyObject* const res = PyList_New(out.size());
+	for (size_t i = 0; i < out.size(); ++i)
+		PyList_SET_ITEM(res, i, PyFloat_FromDouble(out[i]));
+	return res;
+}
+
+//neural_network::get_weights_array(double* out, size_t N_out)
+static PyObject* check_get_weights_array(PyObject*, PyObject* args)
+{
+	PyObject* obj_out = nullptr;
+	if (!PyArg_ParseTuple(args, "O", &obj_out))
+		return nullptr;
+	foxnn_buffer out;
+	if (out.get(obj_out, true) == false)
+		return nullptr;
+	return PyBool_FromLong(network.get_weights_array(out.data, out.rows * out.cols));
+}
+
+//neural_network::set_weights_array(const double* in, size_t N_in)
+static PyObject* check_set_weights_array(PyObject*, PyObject* args)
+{
+	PyObject* obj_in = nullptr;
+	if (!PyArg_ParseTuple(args, "O", &obj_in))
+		return nullptr;
+	foxnn_buffer in;
+	if (in.get(obj_in, false) == false)
+		return nullptr;
+	return PyBool_FromLong(network.set_weights_array(in.data, in.rows * in.cols));
+}
+
+//the %extend neural_network::set_progress_callback of foxnn.i
+static PyObject* check_set_progress_callback(PyObject*, PyObject* args)
+{
+	PyObject* callable = nullptr;
+	Py_ssize_t n_iterations = 1;
+	if (!PyArg_ParseTuple(args, "O|n", &callable, &n_iterations))
+		return nullptr;
+	foxnn_set_progress_callback(network, callable, static_cast<size_t>(n_iterations));
+	Py_RETURN_NONE;
+}
+
+//train_data::add_data_array(const double* in, ..., const double* target, ...) and neural_network::train, both with %thread
+static PyObject* check_train(PyObject*, PyObject* args)
+{
+	PyObject* obj_in = nullptr;
+	PyObject* obj_target = nullptr;
+	Py_ssize_t max_iteration = 0, size_batch = 1;
+	if (!PyArg_ParseTuple(args, "OOnn", &obj_in, &obj_target, &max_iteration, &size_batch))
+		return nullptr;
+	foxnn_buffer in, target;
+	if (in.get(obj_in, false) == false || target.get(obj_target, false) == false)
+		return nullptr;
+	train_data data;
+	bool res = false;
+	Py_BEGIN_ALLOW_THREADS
+	res = data.add_data_array(in.data, in.rows, in.cols, target.data, target.rows, target.cols);
+	Py_END_ALLOW_THREADS
+	if (res == false)
+		return PyBool_FromLong(0);
+	Py_BEGIN_ALLOW_THREADS
+	network.train(data, 0.01, static_cast<size_t>(max_iteration), static_cast<size_t>(size_batch));
+	Py_END_ALLOW_THREADS
+	return PyBool_FromLong(1);
+}
+
+static PyMethodDef check_methods[] =
+{
+	{ "init", check_init, METH_VARARGS, nullptr },
+	{ "get_out_batch", check_get_out_batch, METH_VARARGS, nullptr },
+	{ "get_out", check_get_out, METH_VARARGS, nullptr },
+	{ "get_weights_array", check_get_weights_array, METH_VARARGS, nullptr },
+	{ "set_weights_array", check_set_weights_array, METH_VARARGS, nullptr },
+	{ "set_progress_callback", check_set_progress_callback, METH_VARARGS, nullptr },
+	{ "train", check_train, METH_VARARGS, nullptr },
+	{ nullptr, nullptr, 0, nullptr }
+};
+
+static PyModuleDef check_module = { PyModuleDef_HEAD_INIT, "_foxnn_python_check", nullptr, -1, check_methods, nullptr, nullptr, nullptr, nullptr };
+
+PyMODINIT_FUNC PyInit__foxnn_python_check(void)
+{
+	return PyModule_Create(&check_module);
+}
@@ -0,0 +1,118 @@
+# the check of the code of the Python module in foxnn_python.h: make check_python_glue (builds _foxnn_python_check without swig)
+# the arrays of the typemaps, the release of the Python lock and the progress callback
+# exit code: 0 - passed, 1 - failed
+
+import sys
+import threading
+import time
+import numpy
+import _foxnn_python_check as check
+
+check.init(4, 8, 2)
+
+# float64 rows are read in place, the results are the same as get_out of each row
+x = numpy.random.rand(5, 4)
+out = numpy.empty((5, 2), dtype=numpy.float64)
+assert check.get_out_batch(x, out)
+for i in range(len(x)):
+    assert numpy.allclose(out[i], check.get_out(list(x[i])))
+
+# float32 inputs are converted, a one-dimensional array is one row
+out_32 = numpy.empty((5, 2), dtype=numpy.float64)
+assert check.get_out_batch(x.astype(numpy.float32), out_32)
+assert numpy.allclose(out_32, [check.get_out(list(r)) for r in x.astype(numpy.float32).astype(numpy.float64)])
+row = numpy.empty(2, dtype=numpy.float64)
+assert check.get_out_batch(x[0], row)
+assert numpy.allclose(row, out[0])
+
+# wrong sizes return false, wrong arrays raise an exception and the buffers are released
+assert not check.get_out_batch(x, numpy.empty((4, 2), dtype=numpy.float64))
+assert not check.get_out_batch(x[:, :3].copy(), out)
+errors = [
+    (x.astype(numpy.int64), out, TypeError),
+    (x, out.astype(numpy.float32), TypeError),
+    (x[:, ::2], numpy.empty((5, 2)), (ValueError, BufferError)),
+    (x.reshape(5, 2, 2), out, ValueError),
+]
+readonly = numpy.empty((5, 2), dtype=numpy.float64)
+readonly.setflags(write=False)
+errors.append((x, readonly, (ValueError, BufferError)))
+for args in errors:
+    try:
+        check.get_out_batch(args[0], args[1])
+        assert False, "no exception for %s" % str(args[0].dtype)
+    except args[2]:
+        pass
+grown = numpy.zeros((5, 4))
+assert check.get_out_batch(grown, out)
+grown.resize((6, 4), refcheck=False)  # fails if a view of the array was not released
+
+# the weights through the one-dimensional arrays
+weights = numpy.empty(8 * 5 + 2 * 9, dtype=numpy.float64)
+assert check.get_weights_array(weights)
+assert check.set_weights_array(weights * 0.5)
+assert not check.set_weights_array(weights[:-1])
+check.set_weights_array(weights)
+
+# the callback is called with the Python lock, a true result cancels training
+target = numpy.tile([1.0, 0.0], (20, 1))
+data = numpy.tile(x, (4, 1))
+calls = []
+check.set_progress_callback(lambda iteration, max_iteration: calls.append(iteration) or iteration >= 3)
+assert check.train(data, target, 100, 4)
+assert calls == [1, 2, 3], calls
+
+# every n_iterations iterations and after the last one
+calls = []
+check.set_progress_callback(lambda iteration, max_iteration: calls.append(iteration), 4)
+assert check.train(data, target, 10, 4)
+assert calls == [4, 8, 10], calls
+
+# an exception in the callback or in its truth value stops training and is printed, not left set
+class bad_bool:
+    def __bool__(self):
+        raise RuntimeError("the truth value of the callback result (expected by the check)")
+
+for callback in (lambda i, m: 1 / 0, lambda i, m: bad_bool()):
+    calls = []
+    check.set_progress_callback(lambda i, m, f=callback: calls.append(i) or f(i, m))
+    assert check.train(data, target, 100, 4)
+    assert calls == [1], calls
+
+# None removes the callback and the reference to it
+def counted(iteration, max_iteration):
+    return False
+
+n_references = sys.getrefcount(counted)
+check.set_progress_callback(counted)
+assert sys.getrefcount(counted) == n_references + 1
+check.set_progress_callback(None)
+assert sys.getrefcount(counted) == n_references
+
+# the lock is released during training: the main thread runs Python code while train is called from another thread
+check.set_progress_callback(None)
+# (with the lock held the main thread would stop for the whole training, the longest pause is measured)
+worker = threading.Thread(target=check.train, args=(data, target, 50000, 4))
+start = time.monotonic()
+last = start
+longest_pause = 0.0
+worker.start()
+while worker.is_alive():
+    now = time.monotonic()
+    longest_pause = max(longest_pause, now - last)
+    last = now
+worker.join()
+time_train = time.monotonic() - start
+assert longest_pause < time_train / 2, (longest_pause, time_train)
+
+# the callback of a training thread started from Python takes the lock back
+calls = []
+check.set_progress_callback(lambda iteration, max_iteration: calls.append(iteration) or False, 1000)
+worker = threading.Thread(target=check.train, args=(data, target, 5000, 4))
+worker.start()
+worker.join()
+check.set_progress_callback(None)
+assert calls == list(range(1000, 5001, 1000)), calls
+
+print("passed")
+sys.exit(0)
@@ -0,0 +1,308 @@
+//Copyright[2019][Gaganov Ilya]
+//Licensed under the Apache License, Version 2.0
+
+#pragma once
+
+#include "foxnn.h"
+#include "model_handle.h"
+#include "memory_usage.h"
+#include <iostream>
+#include <vector>
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+using namespace std;
+
+//the cache of the outputs of the network for repeated inputs: the shards with their own locks, eviction by the CLOCK algorithm,
+//the size is limited by bytes; an entry is valid only for the version of the weights it was calculated with,
+//so training, mutation and publishing a new network to model_handle make the old entries misses
+class inference_cache
+{
+public:
+	//tolerance > 0 - the inputs are rounded to multiples of tolerance, and the inputs which are rounded equally share one entry
+	inference_cache(const size_t &new_max_bytes = 64 << 20, const size_t &n_shards = 16, const double &new_tolerance = 0.0) :
+		shards(max(n_shards, static_cast<size_t>(1))), max_bytes(new_max_bytes), tolerance(new_tolerance)
+	{
+		for (size_t i = 0; i < shards.size(); ++i)
+			shards[i].max_bytes = max_bytes / shards.size();
+	}
+
+	vector<double> get_out(const neural_network &nn, const vector<double> &first_in)
+	{
+		vector<double> key;
+		make_key(first_in, key);
+		const uint64_t h = get_hash(key);
+		const size_t version = nn.get_weights_version();
+		shard &s = shards[h % shards.size()];
+
+		vector<double> res;
+		if (find(s, h, key, version, res) == true)
+			return res;
+		res = nn.get_out(first_in);
+		insert(s, h, key, version, res);
+		return res;
+	}
+
+	//the network current in the handle, the version is taken under the same reader as the calculation
+	vector<double> get_out(model_handle &handle, const vector<double> &first_in)
+	{
+		model_handle::reader r = handle.read();
+		return get_out(*r, first_in);
+	}
+
+	void clear()
+	{
+		for (size_t i = 0; i < shards.size(); ++i)
+		{
+			lock_guard <mutex> lock(shards[i].mutex_shard);
+			shards[i].entries.clear();
+			shards[i].index.clear();
+			shards[i].bytes = 0;
+			shards[i].hand = 0;
+		}
+	}
+
+	size_t get_hits() const
+	{
+		return sum(&shard::hits);
+	}
+
+	size_t get_misses() const
+	{
+		return sum(&shard::misses);
+	}
+
+	//the misses because the entry was calculated with other weights
+	size_t get_invalidations() const
+	{
+		return sum(&shard::invalidations);
+	}
+
+	size_t get_evictions() const
+	{
+		return sum(&shard::evictions);
+	}
+
+	size_t get_bytes() const
+	{
+		return sum(&shard::bytes);
+	}
+
+	size_t get_size() const
+	{
+		size_t res = 0;
+		for (size_t i = 0; i < shards.size(); ++i)
+		{
+			lock_guard <mutex> lock(shards[i].mutex_shard);
+			res += shards[i].entries.size();
+		}
+		return res;
+	}
+
+	double get_hit_rate() const
+	{
+		const size_t hits = get_hits();
+		const size_t n = hits + get_misses();
+		return (n == 0) ? 0.0 : static_cast<double>(hits) / n;
+	}
+
+	void reset_stats()
+	{
+		for (size_t i = 0; i < shards.size(); ++i)
+		{
+			lock_guard <mutex> lock(shards[i].mutex_shard);
+			shards[i].hits = shards[i].misses = shards[i].invalidations = shards[i].evictions = 0;
+		}
+	}
+
+	void print_stats() const
+	{
+		cout << "cache: hits = " << get_hits() << " misses = " << get_misses() << " hit rate = " << get_hit_rate()
+			<< " invalidations = " << get_invalidations() << " evictions = " << get_evictions()
+			<< " entries = " << get_size() << " bytes = " << get_bytes() << " of " << max_bytes << endl;
+	}
+
+	//all values by names (for Python)
+	map <string, double> get_stats() const
+	{
+		map <string, double> res;
+		res["hits"] = static_cast<double>(get_hits());
+		res["misses"] = static_cast<double>(get_misses());
+		res["hit_rate"] = get_hit_rate();
+		res["invalidations"] = static_cast<double>(get_invalidations());
+		res["evictions"] = static_cast<double>(get_evictions());
+		res["entries"] = static_cast<double>(get_size());
+		res["bytes"] = static_cast<double>(get_bytes());
+		return res;
+	}
+
+private:
+	struct entry
+	{
+		uint64_t hash;
+		size_t version;
+		vector <double> key;
+		vector <double> out;
+		bool referenced; //was used since the hand of the clock passed it
+		size_t bytes;
+	};
+
+	struct shard
+	{
+		shard() : max_bytes(0), bytes(0), hand(0), hits(0), misses(0), invalidations(0), evictions(0) {}
+
+		mutable mutex mutex_shard;
+		vector <entry> entries;
+		unordered_map <uint64_t, size_t> index; //hash -> the position in entries
+		size_t max_bytes;
+		size_t bytes;
+		size_t hand; //the position of the hand of the clock
+		size_t hits;
+		size_t misses;
+		size_t invalidations;
+		size_t evictions;
+		char padding[64]; //the counters of different shards do not share a cache line
+	};
+
+	bool find(shard &s, const uint64_t &h, const vector<double> &key, const size_t &version, vector<double> &res)
+	{
+		lock_guard <mutex> lock(s.mutex_shard);
+		auto it = s.index.find(h);
+		if (it != s.index.end())
+		{
+			entry &e = s.entries[it->second];
+			if (e.key == key)
+			{
+				if (e.version == version)
+				{
+					e.referenced = true;
+					s.hits++;
+					res = e.out;
+					return true;
+				}
+				s.invalidations++;
+			}
+		}
+		s.misses++;
+		return false;
+	}
+
+	//an entry with the same hash is replaced
+	void insert(shard &s, const uint64_t &h, const vector<double> &key, const size_t &version, const vector<double> &out)
+	{
+		const size_t bytes = get_bytes_entry(key.size(), out.size());
+		if (bytes > s.max_bytes)
+			return;
+		lock_guard <mutex> lock(s.mutex_shard);
+		auto it = s.index.find(h);
+		if (it != s.index.end())
+		{
+			entry &e = s.entries[it->second];
+			s.bytes -= e.bytes;
+			e.version = version;
+			e.key = key;
+			e.out = out;
+			e.referenced = true;
+			e.bytes = bytes;
+			s.bytes += bytes;
+			evict(s, it->second);
+			return;
+		}
+		s.bytes += bytes;
+		evict(s, s.entries.size());
+		s.index[h] = s.entries.size();
+		s.entries.push_back(entry());
+		entry &e = s.entries.back();
+		e.hash = h;
+		e.version = version;
+		e.key = key;
+		e.out = out;
+		e.referenced = false;
+		e.bytes = bytes;
+	}
+
+	//the clock: the hand skips and clears the referenced entries and evicts the first one which was not used, keep - the entry which is not evicted
+	void evict(shard &s, size_t keep)
+	{
+		while (s.bytes > s.max_bytes && s.entries.size() > ((keep < s.entries.size()) ? 1 : 0))
+		{
+			if (s.hand >= s.entries.size())
+				s.hand = 0;
+			entry &e = s.entries[s.hand];
+			if (s.hand == keep || e.referenced == true)
+			{
+				e.referenced = false;
+				s.hand++;
+				continue;
+			}
+			s.bytes -= e.bytes;
+			s.index.erase(e.hash);
+			s.evictions++;
+			//the last entry is moved to the place of the evicted one
+			if (s.hand + 1 != s.entries.size())
+			{
+				if (keep + 1 == s.entries.size())
+					keep = s.hand;
+				e = move(s.entries.back());
+				s.index[e.hash] = s.hand;
+			}
+			s.entries.pop_back();
+		}
+	}
+
+	void make_key(const vector<double> &first_in, vector<double> &key) const
+	{
+		key = first_in;
+		if (tolerance > 0.0)
+			for (size_t i = 0; i < key.size(); ++i)
+				key[i] = round(key[i] / tolerance);
+		for (size_t i = 0; i < key.size(); ++i)
+			if (key[i] == 0.0)
+				key[i] = 0.0; //-0.0 and 0.0 have one hash
+	}
+
+	//the bits of the values mixed by multiplication, and the final mix of murmur3
+	static uint64_t get_hash(const vector<double> &key)
+	{
+		uint64_t h = 0x9E3779B97F4A7C15ull ^ key.size();
+		for (size_t i = 0; i < key.size(); ++i)
+		{
+			uint64_t bits;
+			memcpy(&bits, &key[i], sizeof(bits));
+			h = (h ^ bits) * 0xFF51AFD7ED558CCDull;
+			h ^= h >> 32;
+		}
+		h ^= h >> 33;
+		h *= 0xC4CEB9FE1A85EC53ull;
+		h ^= h >> 33;
+		return h;
+	}
+
+	//the vectors of the key and the outputs, the entry itself and the node of the index
+	static size_t get_bytes_entry(const size_t &N_in, const size_t &N_out)
+	{
+		return sizeof(entry) + memory_usage::get_size_allocation(N_in * sizeof(double)) + memory_usage::get_size_allocation(N_out * sizeof(double))
+			+ memory_usage::get_size_allocation(sizeof(pair<const uint64_t, size_t>) + sizeof(void*)) + sizeof(void*);
+	}
+
+	size_t sum(size_t shard::* counter) const
+	{
+		size_t res = 0;
+		for (size_t i = 0; i < shards.size(); ++i)
+		{
+			lock_guard <mutex> lock(shards[i].mutex_shard);
+			res += shards[i].*counter;
+		}
+		return res;
+	}
+
+	vector <shard> shards;
+	const size_t max_bytes;
+	const double tolerance;
+};
\ No newline at end of file
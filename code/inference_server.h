@@ -0,0 +1,474 @@
+//Copyright[2019][Gaganov Ilya]
+//Licensed under the Apache License, Version 2.0
+
+#pragma once
+
+#include "foxnn.h"
+#include "model_handle.h"
+#include <iostream>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <chrono>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <sstream>
+#endif
+
+using namespace std;
+
+//histogram with the buckets [0, 1), [1, 2), [2, 4), [4, 8) ..., written by one thread and read by any thread
+class histogram
+{
+public:
+	static const size_t N_buckets = 40;
+
+	histogram()
+	{
+		reset();
+	}
+
+	void add(const size_t &value)
+	{
+		size_t k = 0;
+		while (k + 1 < N_buckets && (static_cast<size_t>(1) << k) <= value)
+			k++;
+		buckets[k].fetch_add(1, memory_order_relaxed);
+		count.fetch_add(1, memory_order_relaxed);
+		sum.fetch_add(value, memory_order_relaxed);
+	}
+
+	//the number of values in each bucket, the bucket k > 0 holds the values in [2^(k-1), 2^k)
+	vector <size_t> get_buckets() const
+	{
+		vector <size_t> res(N_buckets);
+		for (size_t k = 0; k < N_buckets; ++k)
+			res[k] = buckets[k].load(memory_order_relaxed);
+		while (res.size() > 1 && res.back() == 0)
+			res.pop_back();
+		return res;
+	}
+
+	size_t get_count() const
+	{
+		return count.load(memory_order_relaxed);
+	}
+
+	double get_mean() const
+	{
+		const size_t n = get_count();
+		return (n == 0) ? 0.0 : static_cast<double>(sum.load(memory_order_relaxed)) / n;
+	}
+
+	//the upper bound of the bucket containing the quantile q
+	size_t get_quantile(const double &q) const
+	{
+		const vector <size_t> b = get_buckets();
+		size_t total = 0;
+		for (size_t k = 0; k < b.size(); ++k)
+			total += b[k];
+		size_t seen = 0;
+		for (size_t k = 0; k < b.size(); ++k)
+		{
+			seen += b[k];
+			if (seen >= q * total && seen != 0)
+				return static_cast<size_t>(1) << k;
+		}
+		return 0;
+	}
+
+	void reset()
+	{
+		for (size_t k = 0; k < N_buckets; ++k)
+			buckets[k].store(0, memory_order_relaxed);
+		count.store(0, memory_order_relaxed);
+		sum.store(0, memory_order_relaxed);
+	}
+
+private:
+	atomic <size_t> buckets[N_buckets];
+	atomic <size_t> count;
+	atomic <size_t> sum;
+};
+
+//the request of one example, the dispatcher completes the promise
+struct inference_request
+{
+	vector <double> input;
+	promise <vector<double>> result;
+	chrono::steady_clock::time_point time_submit;
+	atomic <inference_request*> next;
+};
+
+//the queue of many producers and one consumer without locks (the intrusive queue of Vyukov):
+//push is one atomic exchange, pop is called only by the dispatcher
+class mpsc_queue
+{
+public:
+	mpsc_queue() : head(&stub), tail(&stub)
+	{
+		stub.next.store(nullptr, memory_order_relaxed);
+	}
+
+	void push(inference_request* r)
+	{
+		r->next.store(nullptr, memory_order_relaxed);
+		inference_request* const prev = head.exchange(r, memory_order_acq_rel);
+		prev->next.store(r, memory_order_release);
+	}
+
+	//nullptr - the queue is empty or the producer has not finished push yet
+	inference_request* pop()
+	{
+		inference_request* t = tail;
+		inference_request* next = t->next.load(memory_order_acquire);
+		if (t == &stub)
+		{
+			if (next == nullptr)
+				return nullptr;
+			tail = next;
+			t = next;
+			next = next->next.load(memory_order_acquire);
+		}
+		if (next != nullptr)
+		{
+			tail = next;
+			return t;
+		}
+		if (t != head.load(memory_order_acquire))
+			return nullptr;
+		push(&stub);
+		next = t->next.load(memory_order_acquire);
+		if (next != nullptr)
+		{
+			tail = next;
+			return t;
+		}
+		return nullptr;
+	}
+
+private:
+	atomic <inference_request*> head;
+	inference_request* tail;
+	inference_request stub;
+};
+
+//serving of single examples from any threads: the dispatcher thread gathers up to max_batch requests
+//or waits at most max_wait_us microseconds after the first one, and calculates them in one batch
+class inference_server
+{
+public:
+	inference_server(const neural_network &nn, const size_t &new_max_batch = 32, const size_t &new_max_wait_us = 200, const size_t &n_threads = 1) :
+		network(nn.clone()), handle(nullptr), max_batch(max(new_max_batch, static_cast<size_t>(1))), max_wait_us(new_max_wait_us), stop_flag(false), sleeping(false), n_pending(0)
+	{
+		network.settings.n_threads = max(n_threads, static_cast<size_t>(1));
+		background_threads::add();
+		dispatcher = thread([this]() { const background_threads::guard running; dispatch(); });
+	}
+
+	//each batch is calculated by the network current in the handle, so a new network published to the handle
+	//is served from the next batch without stopping the server, the handle must outlive the server
+	inference_server(model_handle &new_handle, const size_t &new_max_batch = 32, const size_t &new_max_wait_us = 200) :
+		handle(&new_handle), max_batch(max(new_max_batch, static_cast<size_t>(1))), max_wait_us(new_max_wait_us), stop_flag(false), sleeping(false), n_pending(0)
+	{
+		background_threads::add();
+		dispatcher = thread([this]() { const background_threads::guard running; dispatch(); });
+	}
+
+	~inference_server()
+	{
+		stop();
+	}
+
+	//can be called from any thread
+	future <vector<double>> submit(const vector<double> &input)
+	{
+		inference_request* const r = new inference_request();
+		future <vector<double>> res = r->result.get_future();
+		//the request is counted before the check of stop, so the dispatcher does not finish before taking it
+		n_pending.fetch_add(1);
+		if (input.size() != get_N_in() || stop_flag.load() == true)
+		{
+			cout << ((stop_flag.load() == true) ? "the server is stopped" : "the size of the input does not match the network") << endl;
+			n_pending.fetch_sub(1);
+			r->result.set_value(vector<double>());
+			delete r;
+			return res;
+		}
+		r->input = input;
+		r->time_submit = chrono::steady_clock::now();
+		queue.push(r);
+		if (sleeping.load(memory_order_acquire) == true)
+		{
+			lock_guard <mutex> lock(mutex_wake);
+			cv_wake.notify_one();
+		}
+		return res;
+	}
+
+	vector<double> get_out(const vector<double> &input)
+	{
+		return submit(input).get();
+	}
+
+	//the requests already in the queue are completed
+	void stop()
+	{
+		{
+			lock_guard <mutex> lock(mutex_wake);
+			stop_flag.store(true, memory_order_release);
+		}
+		cv_wake.notify_one();
+		if (dispatcher.joinable())
+			dispatcher.join();
+	}
+
+	size_t get_max_batch() const
+	{
+		return max_batch;
+	}
+
+	size_t get_N_in()
+	{
+		return (handle == nullptr) ? network.get_N_in() : handle->read()->get_N_in();
+	}
+
+	void print_stats() const
+	{
+		cout << "requests = " << latency_us.get_count() << " batches = " << batch_size.get_count()
+			<< " mean batch = " << batch_size.get_mean() << " mean queue depth = " << queue_depth.get_mean()
+			<< " latency us: mean = " << latency_us.get_mean() << " p50 < " << latency_us.get_quantile(0.5) << " p99 < " << latency_us.get_quantile(0.99) << endl;
+	}
+
+	histogram queue_depth; //the requests waiting in the queue when a batch starts
+	histogram batch_size;
+	histogram latency_us; //from submit to the result
+
+private:
+	void dispatch()
+	{
+		vector <inference_request*> batch;
+		vector <double> in;
+		vector <double> out;
+		batch.reserve(max_batch);
+
+		while (true)
+		{
+			inference_request* r = queue.pop();
+			if (r == nullptr)
+			{
+				if (stop_flag.load() == true && n_pending.load() == 0)
+					return;
+				wait_request();
+				continue;
+			}
+
+			//gathering the batch until it is full or the first request has waited max_wait_us
+			queue_depth.add(n_pending.load(memory_order_relaxed));
+			batch.push_back(r);
+			const auto deadline = r->time_submit + chrono::microseconds(max_wait_us);
+			while (batch.size() < max_batch)
+			{
+				r = queue.pop();
+				if (r != nullptr)
+				{
+					batch.push_back(r);
+					continue;
+				}
+				if (chrono::steady_clock::now() >= deadline || stop_flag.load(memory_order_relaxed) == true)
+					break;
+				this_thread::yield();
+			}
+
+			if (handle == nullptr)
+				calculate(network, batch, in, out);
+			else
+			{
+				model_handle::reader r = handle->read();
+				calculate(*r, batch, in, out);
+			}
+			n_pending.fetch_sub(batch.size());
+			batch.clear();
+		}
+	}
+
+	//the requests of the wrong size (the network was replaced after submit) receive an empty vector
+	void calculate(const neural_network &nn, const vector <inference_request*> &batch, vector <double> &in, vector <double> &out)
+	{
+		const size_t N_in = nn.get_N_in();
+		const size_t N_out = nn.get_N_out();
+		size_t N = 0;
+		in.resize(batch.size() * N_in);
+		out.resize(batch.size() * N_out);
+		for (size_t i = 0; i < batch.size(); ++i)
+			if (batch[i]->input.size() == N_in)
+				copy(batch[i]->input.cbegin(), batch[i]->input.cend(), in.begin() + (N++) * N_in);
+		if (N != 0)
+			nn.get_out_batch(in.data(), N, N_in, out.data(), N, N_out);
+
+		batch_size.add(batch.size());
+		const auto now = chrono::steady_clock::now();
+		N = 0;
+		for (size_t i = 0; i < batch.size(); ++i)
+		{
+			latency_us.add(chrono::duration_cast<chrono::microseconds>(now - batch[i]->time_submit).count());
+			if (batch[i]->input.size() == N_in)
+			{
+				batch[i]->result.set_value(vector<double>(out.cbegin() + N * N_out, out.cbegin() + (N + 1) * N_out));
+				N++;
+			}
+			else
+				batch[i]->result.set_value(vector<double>());
+			delete batch[i];
+		}
+	}
+
+	//the dispatcher sleeps while the queue is empty, a request which has not finished push is taken after the timeout
+	void wait_request()
+	{
+		unique_lock <mutex> lock(mutex_wake);
+		sleeping.store(true, memory_order_release);
+		if (n_pending.load(memory_order_acquire) == 0 && stop_flag.load(memory_order_acquire) == false)
+			cv_wake.wait_for(lock, chrono::milliseconds(1));
+		sleeping.store(false, memory_order_release);
+	}
+
+	neural_network network;
+	model_handle* handle; //nullptr - the own copy of the network is used
+	const size_t max_batch;
+	const size_t max_wait_us;
+	mpsc_queue queue;
+	thread dispatcher;
+	atomic <bool> stop_flag;
+	atomic <bool> sleeping;
+	atomic <size_t> n_pending; //submitted and not completed requests
+	mutex mutex_wake;
+	condition_variable cv_wake;
+};
+
+#ifndef _WIN32
+//the front end of the server on a local Unix socket for testing: a client sends a line of inputs separated by spaces
+//and receives a line of outputs, each connection is served by its own thread
+class inference_socket
+{
+public:
+	inference_socket(inference_server &new_server) : server(new_server), fd(-1), stop_flag(false) {}
+
+	~inference_socket()
+	{
+		stop();
+	}
+
+	bool start(const string &new_path)
+	{
+		path = new_path;
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		sockaddr_un address = {};
+		address.sun_family = AF_UNIX;
+		if (fd < 0 || path.size() >= sizeof(address.sun_path))
+		{
+			cout << "failed to create socket " << path << endl;
+			return false;
+		}
+		copy(path.cbegin(), path.cend(), address.sun_path);
+		unlink(path.c_str());
+		if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, 64) != 0)
+		{
+			cout << "failed to listen on socket " << path << endl;
+			close(fd);
+			fd = -1;
+			return false;
+		}
+		background_threads::add();
+		acceptor = thread([this]() { const background_threads::guard running; accept_clients(); });
+		return true;
+	}
+
+	void stop()
+	{
+		if (fd < 0)
+			return;
+		stop_flag.store(true);
+		shutdown(fd, SHUT_RDWR);
+		close(fd);
+		fd = -1;
+		if (acceptor.joinable())
+			acceptor.join();
+		lock_guard <mutex> lock(mutex_clients);
+		for (size_t i = 0; i < clients.size(); ++i)
+		{
+			shutdown(client_fds[i], SHUT_RDWR);
+			clients[i].join();
+			close(client_fds[i]);
+		}
+		clients.clear();
+		client_fds.clear();
+		unlink(path.c_str());
+	}
+
+private:
+	void accept_clients()
+	{
+		while (stop_flag.load() == false)
+		{
+			const int client = accept(fd, nullptr, nullptr);
+			if (client < 0)
+				return;
+			lock_guard <mutex> lock(mutex_clients);
+			client_fds.push_back(client);
+			background_threads::add();
+			clients.push_back(thread([this, client]() { const background_threads::guard running; serve(client); }));
+		}
+	}
+
+	void serve(const int &client)
+	{
+		string buffer;
+		char chunk[4096];
+		while (true)
+		{
+			const ssize_t n = read(client, chunk, sizeof(chunk));
+			if (n <= 0)
+				return;
+			buffer.append(chunk, n);
+			size_t end_line;
+			while ((end_line = buffer.find('\n')) != string::npos)
+			{
+				istringstream line(buffer.substr(0, end_line));
+				buffer.erase(0, end_line + 1);
+				vector <double> input;
+				double value;
+				while (line >> value)
+					input.push_back(value);
+
+				const vector <double> out = server.get_out(input);
+				ostringstream answer;
+				answer.precision(17);
+				for (size_t i = 0; i < out.size(); ++i)
+					answer << ((i == 0) ? "" : " ") << out[i];
+				answer << '\n';
+				const string s = answer.str();
+				if (write(client, s.data(), s.size()) < 0)
+					return;
+			}
+		}
+	}
+
+	inference_server &server;
+	string path;
+	int fd;
+	atomic <bool> stop_flag;
+	thread acceptor;
+	mutex mutex_clients;
+	vector <thread> clients;
+	vector <int> client_fds;
+};
+#endif
\ No newline at end of file
@@ -4,6 +4,7 @@
 #pragma once
 
 #include "neuron.h"
+#include "workspace.h"
 #include <iostream>
 #include <fstream>
 #include <vector>
@@ -89,65 +90,109 @@ public:
 	//error count for the previous layer
 	void get_error(vector <double> &out_error, const vector <double> &error, const vector <double> enter, const bool& correct_summation) const
 	{
-		const size_t N_neurons = neurons.size();
-		const size_t N_enter = enter.size();
-		vector <double> d_out(N_neurons);
-		
-
-		out_error.resize(N_enter, 0.0);
-		//calculation of derivatives
-		transform(neurons.cbegin(), neurons.cend(), d_out.begin(), [&](const shared_ptr<neuron> n) 
-			{return n->get_d_out(enter, res_function, correct_summation); }); //	d_out[i] = neurons[i]->get_d_out(enter)
-
-		if (correct_summation == false)
-		{
-			for (size_t i = 0; i < N_enter; ++i)
-				for (size_t j = 0; j < N_neurons; ++j)
-					out_error[i] += error[j] * d_out[j] * neurons[j]->w[i];
-		}
-		else //before summing a large array of small numbers for accuracy they are sorted
-		{
-			vector <vector <double>> for_sum_error(N_enter);
-
-			for (vector<vector <double>>::iterator v = for_sum_error.begin(); v < for_sum_error.end(); ++v)
-				v->resize(N_neurons);
-
-			for (size_t i = 0; i < N_enter; ++i)
-				for (size_t j = 0; j < N_neurons; ++j)
-					for_sum_error[i][j] = error[j] * d_out[j] * neurons[j]->w[i];
+		workspace memory;
+		Settings settings;
+		settings.correct_summation = correct_summation;
+
+		double* const delta = memory.get(neurons.size());
+		get_delta(delta, error.data(), enter, correct_summation, memory);
+		out_error.resize(enter.size());
+		get_error_from_delta(out_error.data(), delta, enter.size(), settings, memory);
+	}
 
-			for (vector<vector <double>>::iterator v = for_sum_error.begin(); v < for_sum_error.end(); ++v)
-				sort(v->begin(), v->end(), f_abs_sort);
+	void back_running(vector <double> &error, const vector <double> &enter, const bool& correct_summation)
+	{
+		workspace memory;
+		Settings settings;
+		settings.correct_summation = correct_summation;
 
-			transform(for_sum_error.cbegin(), for_sum_error.cend(), out_error.begin(), [](const vector<double>& sum_error)
-				{
-					return accumulate(sum_error.cbegin(), sum_error.cend(), 0.0);
-				}); // out_error[i] = sum(for_sum_error[i])
-		}
+		const double* const out_error = back_running(error.data(), enter, settings, memory);
+		error.assign(out_error, out_error + enter.size());
 	}
 
-
-	void back_running(vector <double> &error, const vector <double> &enter, const bool& correct_summation)
+	//back propagation of the error through the layer, the temporary values are taken from the workspace of the calling thread
+	//returns the error for the previous layer (enter.size() values in memory)
+	double* back_running(const double* error, const vector <double> &enter, const Settings &settings, workspace &memory)
 	{
 		const size_t N_neurons = neurons.size();
-		vector <double> out_error;
+
+		double* const delta = memory.get(N_neurons);
+		get_delta(delta, error, enter, settings.correct_summation, memory); //delta[i] = error[i] * f'(sum[i])
+
 		//error count for the previous layer
-		get_error(out_error, error, enter, correct_summation);
+		double* const out_error = memory.get(enter.size());
+		get_error_from_delta(out_error, delta, enter.size(), settings, memory);
 
 		//The calculation of the derivative(momentum) for the weights
 		for (size_t i = 0; i < N_neurons; ++i)
-			neurons[i]->derivate_w(error[i], enter, res_function, correct_summation);
-		error = move(out_error);
+			neurons[i]->derivate_w(delta[i], enter);
+		return out_error;
+	}
+
+	//the size of the workspace required by back_running
+	size_t get_size_workspace(const bool& correct_summation) const
+	{
+		const size_t N_neurons = neurons.size();
+		const size_t N_enter = get_N_w();
+		if (correct_summation == false)
+			return N_neurons + N_enter; //delta, out_error
+		return 2 * N_neurons + 2 * N_enter + 1; //delta, out_error and buffers for sorting
 	}
 
 	//calculate the value of the layer
 	void get_out(const vector <double> &enter, vector <double> &out, const bool& correct_summation = false) const
 	{
 		out.resize(neurons.size());
-		transform(neurons.cbegin(), neurons.cend(), out.begin(), [&](const shared_ptr<neuron> n) 
+		transform(neurons.cbegin(), neurons.cend(), out.begin(), [&](const shared_ptr<neuron> &n) 
 			{return n->get_out(enter, res_function, correct_summation); }); //out[i] = neurot[i].get_out(entr)
 	}
 
+	//the same for enter of get_N_w() values read in place
+	void get_out(const double* enter, vector <double> &out, const bool& correct_summation = false) const
+	{
+		out.resize(neurons.size());
+		transform(neurons.cbegin(), neurons.cend(), out.begin(), [&](const shared_ptr<neuron> &n)
+			{return n->get_out(enter, res_function, correct_summation); });
+	}
+
+	//the outputs for N_batch inputs one after another into out (N_batch rows of get_N_n() values),
+	//the weights of each neuron are read once for 4 inputs, the sums are the same as in get_out without correct_summation
+	void get_out_batch(const double* enter, const size_t &N_batch, double* out, const size_t &n_threads, const size_t &min_parallel_work) const
+	{
+		const size_t N_in = get_N_w();
+		const size_t N_n = neurons.size();
+#pragma omp parallel for num_threads(n_threads) if(N_n * N_batch * N_in > min_parallel_work)
+		for (long long n = 0; n < static_cast<long long>(N_n); ++n)
+		{
+			const double* const w = neurons[n]->w.data();
+			size_t b = 0;
+			for (; b + 4 <= N_batch; b += 4)
+			{
+				const double* const x = enter + b * N_in;
+				double sum_0 = 0.0, sum_1 = 0.0, sum_2 = 0.0, sum_3 = 0.0;
+				for (size_t i = 0; i < N_in; ++i)
+				{
+					sum_0 += x[i] * w[i];
+					sum_1 += x[N_in + i] * w[i];
+					sum_2 += x[2 * N_in + i] * w[i];
+					sum_3 += x[3 * N_in + i] * w[i];
+				}
+				out[b * N_n + n] = res_function->get_out(sum_0 + -w[N_in]);
+				out[(b + 1) * N_n + n] = res_function->get_out(sum_1 + -w[N_in]);
+				out[(b + 2) * N_n + n] = res_function->get_out(sum_2 + -w[N_in]);
+				out[(b + 3) * N_n + n] = res_function->get_out(sum_3 + -w[N_in]);
+			}
+			for (; b < N_batch; ++b)
+			{
+				const double* const x = enter + b * N_in;
+				double sum = 0.0;
+				for (size_t i = 0; i < N_in; ++i)
+					sum += x[i] * w[i];
+				out[b * N_n + n] = res_function->get_out(sum + -w[N_in]);
+			}
+		}
+	}
+
 	//change the weights after calculating the momentum
 	void correction_of_scales(const double& speed, const Settings &setting)
 	{
@@ -168,6 +213,36 @@ public:
 		return neurons.size();
 	}
 
+	//get the number of all weights of the layer
+	size_t get_N_weights(void) const
+	{
+		return neurons.size() * (get_N_w() + 1);
+	}
+
+	//copying all weights into res[0..get_N_weights()) neuron by neuron
+	void get_weights(double* res) const
+	{
+		for (size_t i = 0; i < neurons.size(); ++i)
+			res = copy(neurons[i]->w.cbegin(), neurons[i]->w.cend(), res);
+	}
+
+	//setting all weights from new_w[0..get_N_weights()) neuron by neuron
+	void set_weights(const double* new_w)
+	{
+		for (size_t i = 0; i < neurons.size(); ++i)
+		{
+			copy(new_w, new_w + neurons[i]->w.size(), neurons[i]->w.begin());
+			new_w += neurons[i]->w.size();
+		}
+	}
+
+	//copying the weights of the layer a with the same sizes without allocations
+	void copy_weights(const layer &a)
+	{
+		for (size_t i = 0; i < neurons.size(); ++i)
+			copy(a.neurons[i]->w.cbegin(), a.neurons[i]->w.cend(), neurons[i]->w.begin());
+	}
+
 	//randomly change the weights to a random value
 	void random_mutation(const double &speed)
 	{
@@ -184,6 +259,24 @@ public:
 			neurons[i]->smart_mutation(speed);
 	}
 
+	//filling the weights with random values
+	//"uniform" - uniform in [-1, 1], "xavier" - uniform in [-sqrt(6 / (n_in + n_out)), sqrt(6 / (n_in + n_out))],
+	//"he" - normal with deviation sqrt(2 / n_in)
+	void init_weights(const string &name = "uniform")
+	{
+		const size_t N_neurons = neurons.size();
+		const double N_in = static_cast<double>(get_N_w());
+		for (size_t i = 0; i < N_neurons; ++i)
+		{
+			if (name == "xavier")
+				neurons[i]->init_uniform(sqrt(6.0 / (N_in + N_neurons)));
+			else if (name == "he")
+				neurons[i]->init_normal(sqrt(2.0 / N_in));
+			else
+				get_random_generator().uniform(neurons[i]->w.data(), neurons[i]->w.size(), -1.0, 1.0);
+		}
+	}
+
 	~layer()
 	{
 	}
@@ -250,7 +343,24 @@ public:
 			res_function = get_activation_function(activ_f);
 		return;
 	}
+	//the heap memory of the layer without the object of the layer,
+	//category != "" - only the neurons and the weights are counted in the given category (for the copies of the weights)
+	void add_memory(memory_usage &report, const string &category = "") const
+	{
+		report.add_vector((category == "") ? "neurons" : category, neurons);
+		report.add_shared((category == "") ? "neurons" : category, sizeof(neuron), neurons.size());
+		for (size_t i = 0; i < neurons.size(); ++i)
+			neurons[i]->add_memory(report, category);
+		if (category != "")
+			return;
+		report.add_vector("activations", output);
+		for (size_t i = 0; i < output.size(); ++i)
+			report.add_vector("activations", output[i]);
+	}
+
 	friend class neural_network;
+	friend class ensemble;
+	friend class benchmark;
 
 	void print(const size_t& num_lauer = 0)
 	{
@@ -258,6 +368,118 @@ public:
 	}
 private:
 
+	//back propagation for the asynchronous training: the derivatives are added to gradient[0..get_N_weights()) of the calling thread
+	//instead of the state of the optimizer shared by the threads, returns the error for the previous layer
+	double* back_running_local(const double* error, const vector <double> &enter, const Settings &settings, workspace &memory, double* gradient) const
+	{
+		const size_t N_neurons = neurons.size();
+		const size_t N_w = get_N_w();
+
+		double* const delta = memory.get(N_neurons);
+		get_delta(delta, error, enter, settings.correct_summation, memory);
+		double* const out_error = memory.get(enter.size());
+		get_error_from_delta(out_error, delta, enter.size(), settings, memory);
+
+		for (size_t i = 0; i < N_neurons; ++i)
+		{
+			double* const g = gradient + i * (N_w + 1);
+			for (size_t j = 0; j < N_w; ++j)
+				g[j] += enter[j] * delta[i];
+			g[N_w] -= delta[i];
+		}
+		return out_error;
+	}
+
+	//the derivatives summed by back_running for the weights in the order of get_weights
+	void get_derivatives(double* res) const
+	{
+		for (size_t i = 0; i < neurons.size(); ++i)
+			for (size_t j = 0; j < neurons[i]->optimization.size(); ++j)
+				*(res++) = neurons[i]->optimization[j]->derivative;
+	}
+
+	void set_derivatives(const double* new_derivatives)
+	{
+		for (size_t i = 0; i < neurons.size(); ++i)
+			for (size_t j = 0; j < neurons[i]->optimization.size(); ++j)
+				neurons[i]->optimization[j]->derivative = *(new_derivatives++);
+	}
+
+	//w -= speed * gradient without locks (Hogwild): the updates of other threads may come in between, but none is lost;
+	//velocity != nullptr - the momentum of Nesterov kept by the calling thread
+	void add_gradient_async(const double* gradient, const double &speed, double* velocity, const double &gamma)
+	{
+		for (size_t i = 0; i < neurons.size(); ++i)
+		{
+			double* const w = neurons[i]->w.data();
+			const size_t N = neurons[i]->w.size();
+			for (size_t j = 0; j < N; ++j)
+			{
+				double step = speed * gradient[j];
+				if (velocity != nullptr)
+				{
+					velocity[j] = gamma * velocity[j] + step;
+					step = velocity[j];
+				}
+#pragma omp atomic
+				w[j] -= step;
+			}
+			gradient += N;
+			if (velocity != nullptr)
+				velocity += N;
+		}
+	}
+
+	//multiplication of the error by the derivative of the activation function: delta[i] = error[i] * f'(sum[i])
+	void get_delta(double* delta, const double* error, const vector <double> &enter, const bool& correct_summation, workspace &memory) const
+	{
+		const size_t N_neurons = neurons.size();
+		double* const buffer = (correct_summation == false) ? nullptr : memory.get(get_N_w() + 1);
+		for (size_t i = 0; i < N_neurons; ++i)
+		{
+			const double sum = neurons[i]->scalar_product(enter, correct_summation, buffer); //w[0]*enter[0] + w[1]*enter[1] + ...
+			delta[i] = error[i] * res_function->get_derivative_out(sum);
+		}
+	}
+
+	//error count for the previous layer: out_error = W^T * delta
+	void get_error_from_delta(double* out_error, const double* delta, const size_t &N_enter, const Settings &settings, workspace &memory) const
+	{
+		const size_t N_neurons = neurons.size();
+		fill(out_error, out_error + N_enter, 0.0);
+
+		if (settings.correct_summation == false)
+		{
+			//the inputs are divided into blocks: the block of out_error stays in the cache, 
+			//and the weights of each neuron are read sequentially
+			const size_t size_block = (settings.size_block == 0) ? N_enter : settings.size_block;
+			for (size_t begin = 0; begin < N_enter; begin += size_block)
+			{
+				const size_t end = min(begin + size_block, N_enter);
+				for (size_t j = 0; j < N_neurons; ++j)
+				{
+					const double d = delta[j];
+					const double* const w = neurons[j]->w.data();
+#pragma omp simd
+					for (size_t i = begin; i < end; ++i)
+						out_error[i] += d * w[i]; //out_error[i] += error[j] * f'(sum[j]) * w[j][i]
+				}
+			}
+		}
+		else //before summing a large array of small numbers for accuracy they are sorted
+		{
+			double* const buffer = memory.get(N_neurons);
+			for (size_t i = 0; i < N_enter; ++i)
+			{
+				for (size_t j = 0; j < N_neurons; ++j)
+					buffer[j] = delta[j] * neurons[j]->w[i];
+
+				sort(buffer, buffer + N_neurons, f_abs_sort);
+				out_error[i] = accumulate(buffer, buffer + N_neurons, 0.0);
+			}
+		}
+	}
+
 	void init_memory_for_train(const size_t & size_batch, const Settings &settings)
 	{
 		for (size_t i = 0; i < neurons.size(); ++i)
@@ -0,0 +1,100 @@
+//Copyright[2019][Gaganov Ilya]
+//Licensed under the Apache License, Version 2.0
+
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <map>
+#include <memory>
+#include <iomanip>
+#include <algorithm>
+
+using namespace std;
+
+//the bytes of the heap by categories: the bytes requested by the containers and objects,
+//and the estimate of the overhead of the allocator in the category "allocator_overhead"
+class memory_usage
+{
+public:
+	memory_usage() : n_allocations(0) {}
+
+	//n_allocations blocks of size bytes each
+	void add(const string &category, const size_t &size, const size_t &n_allocations_add = 1)
+	{
+		if (size == 0 || n_allocations_add == 0)
+			return;
+		bytes[category] += size * n_allocations_add;
+		bytes["allocator_overhead"] += (get_size_allocation(size) - size) * n_allocations_add;
+		n_allocations += n_allocations_add;
+	}
+
+	//the memory of the vector (capacity), the object of the vector itself is a part of its owner
+	template <typename T>
+	void add_vector(const string &category, const vector<T> &v)
+	{
+		add(category, v.capacity() * sizeof(T));
+	}
+
+	//the object created by make_shared: one block with the counters of the pointer
+	void add_shared(const string &category, const size_t &size_object, const size_t &n = 1)
+	{
+		add(category, size_object + size_shared_counters, n);
+	}
+
+	void merge(const memory_usage &a)
+	{
+		for (auto it = a.bytes.cbegin(); it != a.bytes.cend(); ++it)
+			bytes[it->first] += it->second;
+		n_allocations += a.n_allocations;
+	}
+
+	size_t get_total() const
+	{
+		size_t res = 0;
+		for (auto it = bytes.cbegin(); it != bytes.cend(); ++it)
+			res += it->second;
+		return res;
+	}
+
+	size_t get(const string &category) const
+	{
+		auto it = bytes.find(category);
+		return (it == bytes.end()) ? 0 : it->second;
+	}
+
+	void print() const
+	{
+		cout << "memory: total = " << get_total() << " bytes (" << fixed << setprecision(3) << get_total() / 1048576.0 << " MB)"
+			<< " n_allocations = " << n_allocations << endl;
+		for (auto it = bytes.cbegin(); it != bytes.cend(); ++it)
+			cout << "  " << it->first << " = " << it->second << endl;
+	}
+
+	//all values by names (for Python)
+	map <string, double> to_map() const
+	{
+		map <string, double> res;
+		for (auto it = bytes.cbegin(); it != bytes.cend(); ++it)
+			res[it->first] = static_cast<double>(it->second);
+		res["total"] = static_cast<double>(get_total());
+		res["n_allocations"] = static_cast<double>(n_allocations);
+		return res;
+	}
+
+	//the size of the block given by a typical allocator (glibc malloc): a header of one pointer,
+	//alignment to 2 pointers and the minimum block of 4 pointers
+	static size_t get_size_allocation(const size_t &size)
+	{
+		const size_t align = 2 * sizeof(void*);
+		const size_t res = (size + sizeof(void*) + align - 1) / align * align;
+		return max(res, 4 * sizeof(void*));
+	}
+
+	map <string, size_t> bytes;
+	size_t n_allocations;
+
+	//the counters and the virtual table of the control block of make_shared
+	static const size_t size_shared_counters = sizeof(void*) + 2 * sizeof(int);
+};
\ No newline at end of file
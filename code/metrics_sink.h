@@ -0,0 +1,224 @@
+//Copyright[2019][Gaganov Ilya]
+//Licensed under the Apache License, Version 2.0
+
+#pragma once
+
+#include "test_metrics.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <iomanip>
+
+using namespace std;
+
+//one event of training: "iteration" - after each iteration, "testing" - the result of testing,
+//"early_stopping" - training is stopped (iteration and metrics.error of the best weights), "finish" - the end of train
+class training_record
+{
+public:
+	training_record() : iteration(0), max_iteration(0), size_batch(0), loss(0.0), speed(0.0), time(0.0), samples_per_second(0.0), elapsed(0.0) {}
+
+	training_record(const string &new_type) : training_record()
+	{
+		type = new_type;
+	}
+
+	//one line of JSON without the line break
+	string to_json() const
+	{
+		ostringstream res;
+		res << setprecision(10);
+		res << "{\"type\":\"" << type << "\",\"iteration\":" << iteration << ",\"max_iteration\":" << max_iteration
+			<< ",\"elapsed\":" << elapsed;
+		if (type == "iteration")
+			res << ",\"size_batch\":" << size_batch << ",\"loss\":" << loss << ",\"speed\":" << speed
+				<< ",\"time\":" << time << ",\"samples_per_second\":" << samples_per_second;
+		if (type == "testing" || type == "early_stopping")
+			res << ",\"error\":" << metrics.error << ",\"n_true\":" << metrics.n_true << ",\"size\":" << metrics.size << ",\"time\":" << metrics.time;
+		res << "}";
+		return res.str();
+	}
+
+	string type;
+	size_t iteration;
+	size_t max_iteration;
+	size_t size_batch;
+	double loss; //mean over the batch of the sum of absolute errors of the outputs, as test_metrics::error
+	double speed; //the learning rate
+	double time; //wall time of the iteration
+	double samples_per_second;
+	double elapsed; //wall time since the beginning of train
+	test_metrics metrics;
+};
+
+//the receiver of the records of training, write is called by the training thread
+class metrics_sink
+{
+public:
+	virtual ~metrics_sink() {}
+	virtual void write(const training_record &r) = 0;
+	virtual void flush() {}
+};
+
+//the records are written to a file one JSON per line, the writing to disk is done by a separate thread
+class jsonl_sink : public metrics_sink
+{
+public:
+	jsonl_sink(const string &name_file, const bool &append = false) : stop(false), n_queued(0)
+	{
+		file.open(name_file, (append == true) ? ios::app : ios::trunc);
+		if (!file.is_open())
+		{
+			cout << "failed to open file " << name_file << endl;
+			return;
+		}
+		writer = thread([this]() { write_queue(); });
+	}
+
+	~jsonl_sink()
+	{
+		{
+			lock_guard <mutex> lock(mutex_queue);
+			stop = true;
+		}
+		cv_queue.notify_one();
+		if (writer.joinable())
+			writer.join();
+	}
+
+	void write(const training_record &r) override
+	{
+		if (!file.is_open())
+			return;
+		string line = r.to_json();
+		{
+			lock_guard <mutex> lock(mutex_queue);
+			queue.push_back(move(line));
+			n_queued++;
+		}
+		cv_queue.notify_one();
+	}
+
+	//waiting until all records are written to the file
+	void flush() override
+	{
+		unique_lock <mutex> lock(mutex_queue);
+		cv_written.wait(lock, [this]() {return queue.size() == 0 && n_queued == 0; });
+	}
+
+private:
+	void write_queue()
+	{
+		deque <string> lines;
+		unique_lock <mutex> lock(mutex_queue);
+		while (true)
+		{
+			cv_queue.wait(lock, [this]() {return stop == true || queue.size() != 0; });
+			if (queue.size() == 0 && stop == true)
+				return;
+			lines.swap(queue);
+			lock.unlock();
+
+			for (size_t i = 0; i < lines.size(); ++i)
+				file << lines[i] << '\n';
+			file.flush();
+
+			lock.lock();
+			n_queued -= lines.size();
+			lines.clear();
+			cv_written.notify_all();
+		}
+	}
+
+	ofstream file;
+	thread writer;
+	mutex mutex_queue;
+	condition_variable cv_queue;
+	condition_variable cv_written;
+	deque <string> queue;
+	bool stop;
+	size_t n_queued; //records not yet written to the file
+};
+
+//the last size records are kept in memory
+class ring_sink : public metrics_sink
+{
+public:
+	ring_sink(const size_t &size = 1024) : records(max(size, static_cast<size_t>(1))), n_records(0) {}
+
+	void write(const training_record &r) override
+	{
+		lock_guard <mutex> lock(mutex_records);
+		records[n_records % records.size()] = r;
+		n_records++;
+	}
+
+	//the kept records from the oldest to the newest
+	vector <training_record> get_records() const
+	{
+		lock_guard <mutex> lock(mutex_records);
+		const size_t N = min(n_records, records.size());
+		vector <training_record> res;
+		res.reserve(N);
+		for (size_t k = n_records - N; k < n_records; ++k)
+			res.push_back(records[k % records.size()]);
+		return res;
+	}
+
+	//all records written, including the overwritten ones
+	size_t get_n_records() const
+	{
+		lock_guard <mutex> lock(mutex_records);
+		return n_records;
+	}
+
+	void clear()
+	{
+		lock_guard <mutex> lock(mutex_records);
+		n_records = 0;
+	}
+
+private:
+	vector <training_record> records;
+	size_t n_records;
+	mutable mutex mutex_records;
+};
+
+//each record is given to the function of the user in the training thread
+class callback_sink : public metrics_sink
+{
+public:
+	callback_sink(const function<void(const training_record&)> &new_callback) : callback(new_callback) {}
+
+	void write(const training_record &r) override
+	{
+		if (callback)
+			callback(r);
+	}
+
+private:
+	function<void(const training_record&)> callback;
+};
+
+//one line per record without progress bars: the results of testing and every n_print-th iteration (0 - no iterations)
+class console_sink : public metrics_sink
+{
+public:
+	console_sink(const size_t &new_n_print = 0) : n_print(new_n_print) {}
+
+	void write(const training_record &r) override
+	{
+		if (r.type == "iteration" && (n_print == 0 || r.iteration % n_print != 0))
+			return;
+		cout << r.to_json() << endl;
+	}
+
+	size_t n_print;
+};
\ No newline at end of file
@@ -0,0 +1,241 @@
+//Copyright[2019][Gaganov Ilya]
+//Licensed under the Apache License, Version 2.0
+
+#pragma once
+
+#include "foxnn.h"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <future>
+#include <functional>
+#include <algorithm>
+
+using namespace std;
+
+//the current network for serving: readers never take locks and never wait for the writer,
+//a new network is published by one atomic exchange and the old one is deleted when no reader uses it (epoch-based reclamation)
+class model_handle
+{
+public:
+	//access to the current network, the network is not deleted while the reader exists
+	class reader
+	{
+	public:
+		reader(model_handle &new_handle) : handle(&new_handle), slot(new_handle.enter()), network(new_handle.current.load()) {}
+
+		reader(reader &&a) noexcept : handle(a.handle), slot(a.slot), network(a.network)
+		{
+			a.handle = nullptr;
+		}
+
+		~reader()
+		{
+			if (handle != nullptr)
+				handle->leave(slot);
+		}
+
+		const neural_network& operator* () const
+		{
+			return *network;
+		}
+
+		const neural_network* operator-> () const
+		{
+			return network;
+		}
+
+	private:
+		reader(const reader&) = delete;
+		reader& operator= (const reader&) = delete;
+
+		model_handle* handle;
+		size_t slot;
+		const neural_network* network;
+	};
+
+	//max_readers - the number of slots for the readers at the same time, a reader waits only if all slots are taken
+	model_handle(const neural_network &nn, const size_t &max_readers = 64) :
+		current(new neural_network(nn.clone())), epoch(1), version(1), slots(max(max_readers, static_cast<size_t>(1)))
+	{
+		for (size_t i = 0; i < slots.size(); ++i)
+			slots[i].epoch.store(0, memory_order_relaxed);
+	}
+
+	//there must be no readers
+	~model_handle()
+	{
+		if (loader.valid())
+			loader.wait();
+		delete current.load();
+		for (size_t i = 0; i < retired.size(); ++i)
+			delete retired[i].network;
+	}
+
+	reader read()
+	{
+		return reader(*this);
+	}
+
+	vector<double> get_out(const vector<double> &first_in)
+	{
+		reader r(*this);
+		return r->get_out(first_in);
+	}
+
+	bool get_out_batch(const double* in, size_t N_rows_in, size_t N_cols_in, double* out, size_t N_rows_out, size_t N_cols_out)
+	{
+		reader r(*this);
+		return r->get_out_batch(in, N_rows_in, N_cols_in, out, N_rows_out, N_cols_out);
+	}
+
+	//the new network is visible to the readers which start after the call, returns the version of the network
+	size_t publish(neural_network &&nn)
+	{
+		neural_network* const network = new neural_network(move(nn));
+		lock_guard <mutex> lock(mutex_publish);
+		neural_network* const old = current.exchange(network);
+		const size_t old_epoch = epoch.fetch_add(1);
+		retired.push_back(retired_network(old, old_epoch));
+		const size_t res = version.fetch_add(1) + 1;
+		reclaim_locked();
+		return res;
+	}
+
+	size_t publish(const neural_network &nn)
+	{
+		return publish(nn.clone());
+	}
+
+	//reading the network from the file in the calling thread and publishing it, the current network is kept on error
+	bool load(const string &name_file)
+	{
+		if (ifstream(name_file).good() == false)
+		{
+			cout << "failed to open file " << name_file << endl;
+			return false;
+		}
+		neural_network nn(name_file);
+		if (nn.get_N_in() == 0 || nn.get_N_out() == 0)
+		{
+			cout << "failed to read network from file " << name_file << endl;
+			return false;
+		}
+		publish(move(nn));
+		return true;
+	}
+
+	//the same in a background thread, the serving threads are not affected
+	void load_async(const string &name_file, const function<void(bool)> &on_done = nullptr)
+	{
+		lock_guard <mutex> lock(mutex_loader);
+		if (loader.valid())
+			loader.wait();
+		background_threads::add();
+		loader = async(launch::async, [this, name_file, on_done]()
+		{
+			const background_threads::guard running;
+			const bool res = load(name_file);
+			if (on_done)
+				on_done(res);
+		});
+	}
+
+	//deleting the old networks which are not used by readers, returns the number of networks still waiting
+	size_t reclaim()
+	{
+		lock_guard <mutex> lock(mutex_publish);
+		return reclaim_locked();
+	}
+
+	//waiting until all readers of the old networks are finished and deleting them
+	void synchronize()
+	{
+		while (reclaim() != 0)
+			this_thread::yield();
+	}
+
+	//increases with each publish
+	size_t get_version() const
+	{
+		return version.load();
+	}
+
+	//a copy of the current network, for example to continue training
+	neural_network get_copy()
+	{
+		reader r(*this);
+		return r->clone();
+	}
+
+private:
+	struct reader_slot
+	{
+		atomic <size_t> epoch; //0 - free
+		char padding[64]; //the slots of different threads do not share a cache line
+	};
+
+	struct retired_network
+	{
+		retired_network(neural_network* new_network, const size_t &new_epoch) : network(new_network), epoch(new_epoch) {}
+
+		neural_network* network;
+		size_t epoch; //the last epoch in which the network was current
+	};
+
+	//the slot of the reader marked with the current epoch, the search starts from the slot of the thread
+	size_t enter()
+	{
+		const size_t N = slots.size();
+		size_t i = hash<thread::id>()(this_thread::get_id()) % N;
+		while (true)
+		{
+			const size_t e = epoch.load();
+			for (size_t k = 0; k < N; ++k, i = (i + 1 == N) ? 0 : i + 1)
+			{
+				size_t expected = 0;
+				if (slots[i].epoch.load(memory_order_relaxed) == 0 && slots[i].epoch.compare_exchange_strong(expected, e))
+					return i;
+			}
+			this_thread::yield();
+		}
+	}
+
+	void leave(const size_t &slot)
+	{
+		slots[slot].epoch.store(0, memory_order_release);
+	}
+
+	//a reader in the epoch e may use only the networks which were current in the epochs >= e
+	size_t reclaim_locked()
+	{
+		size_t min_epoch = epoch.load();
+		for (size_t i = 0; i < slots.size(); ++i)
+		{
+			const size_t e = slots[i].epoch.load();
+			if (e != 0)
+				min_epoch = min(min_epoch, e);
+		}
+		size_t n_kept = 0;
+		for (size_t i = 0; i < retired.size(); ++i)
+			if (retired[i].epoch < min_epoch)
+				delete retired[i].network;
+			else
+				retired[n_kept++] = retired[i];
+		retired.resize(n_kept, retired_network(nullptr, 0));
+		return n_kept;
+	}
+
+	atomic <neural_network*> current;
+	atomic <size_t> epoch;
+	atomic <size_t> version;
+	vector <reader_slot> slots;
+	vector <retired_network> retired;
+	mutex mutex_publish;
+	mutex mutex_loader;
+	future <void> loader;
+};
\ No newline at end of file
@@ -15,6 +15,7 @@
 #include <memory>
 #include <iomanip>
 #include "optimization.h"
+#include "memory_usage.h"
 
 using namespace std;
 
@@ -29,11 +30,8 @@ public:
 	//Creation of a neuron with random filling of scales
 	neuron(const size_t &N)
 	{
-		random_device rd;
-		std::mt19937 gen(rd());
-		uniform_real_distribution<> urd(-1, 1);
 		w.resize(N + 1);
-		generate(w.begin(), w.end(), [&]() {return urd(gen); });
+		get_random_generator().uniform(w.data(), w.size(), -1.0, 1.0);
 	}
 
 	//Creating a neuron by reading weights from a file
@@ -88,6 +86,23 @@ public:
 			optimization[i]->derivative += enter[i] * d_res_function_multiplied_error; // d[i] = d[i] + enter[i] * error * f'(sum)
 		}
 
+#pragma omp atomic
+		optimization.back()->derivative -= d_res_function_multiplied_error;
+
+		return;
+	}
+
+	//The calculation of the derivative(momentum) for the weights when error * f'(sum) is already known
+	void derivate_w(const double &d_res_function_multiplied_error, const vector <double> &enter)
+	{
+		const size_t N_w = w.size();
+
+		for (size_t i = 0; i < N_w - 1; ++i)
+		{
+#pragma omp atomic
+			optimization[i]->derivative += enter[i] * d_res_function_multiplied_error; // d[i] = d[i] + enter[i] * error * f'(sum)
+		}
+
 #pragma omp atomic
 		optimization.back()->derivative -= d_res_function_multiplied_error;
 
@@ -112,6 +127,26 @@ public:
 		return  func->get_out(sum); //f(sum)
 	}
 
+	//the same for enter of w.size() - 1 values read in place (a row of an array)
+	double get_out(const double* enter, const activation_function &func, const bool& correct_summation = false) const
+	{
+		const double sum = scalar_product(enter, correct_summation); //w[0]*enter[0] + w[1]*enter[1] + ...
+		return  func->get_out(sum); //f(sum)
+	}
+
+	//filling the weights with random values: uniform in [-limit, limit] or normal with deviation sigma, the shift w.back() = 0
+	void init_uniform(const double &limit)
+	{
+		get_random_generator().uniform(w.data(), w.size() - 1, -limit, limit);
+		w.back() = 0.0;
+	}
+
+	void init_normal(const double &sigma)
+	{
+		get_random_generator().normal(w.data(), w.size() - 1, 0.0, sigma);
+		w.back() = 0.0;
+	}
+
 	//outputs the number of weights (excluding the last)
 	size_t get_N(void) const
 	{
@@ -122,11 +157,9 @@ public:
 	void random_mutation(const double &speed)
 	{
 		const size_t N_w = w.size();
-		random_device rd;
-		std::mt19937 gen(rd());
-		std::uniform_real_distribution<> urd(-1, 1);
+		random_generator& gen = get_random_generator();
 		for (size_t i = 0; i < N_w; ++i)
-			w[i] += urd(gen) * speed;
+			w[i] += gen.uniform(-1.0, 1.0) * speed;
 	}
 
 	//change of weights by a value commensurate with the value of weights
@@ -135,13 +168,9 @@ public:
 		if (speed >= 0 && speed <= 0)
 			return;
 		const size_t N_w = w.size();
-		random_device rd;
-		std::mt19937 gen(rd());
+		random_generator& gen = get_random_generator();
 		for (size_t i = 0; i < N_w; ++i)
-		{
-			std::uniform_real_distribution<> urd(w[i] - fabs(w[i] * speed), w[i] + fabs(w[i] * speed));
-			w[i] = urd(gen);
-		}
+			w[i] += gen.uniform(-1.0, 1.0) * fabs(w[i] * speed); //w[i] in [w[i] - |w[i] * speed|, w[i] + |w[i] * speed|]
 	}
 
 	//operator = copy
@@ -166,26 +195,54 @@ public:
 		return *this;
 	}
 
+	//the heap memory of the neuron without the object of the neuron,
+	//category != "" - only the weights are counted in the given category (for the copies of the weights)
+	void add_memory(memory_usage &report, const string &category = "") const
+	{
+		report.add_vector((category == "") ? "weights" : category, w);
+		if (category != "")
+			return;
+		report.add_vector("optimizer", optimization);
+		if (optimization.size() != 0)
+			report.add_shared("optimizer", optimization[0]->get_size(), optimization.size());
+	}
+
 	friend class layer;
+	friend class benchmark;
 private:
 
 	//w[0]*enter[0] + w[1]*enter[1] + ...
-	double scalar_product(const vector <double>& enter, const bool& correct_summation) const
+	//buffer - memory for w.size() values for the correct summation, if nullptr it is allocated
+	double scalar_product(const vector <double>& enter, const bool& correct_summation, double* buffer = nullptr) const
+	{
+		return scalar_product(enter.data(), correct_summation, buffer);
+	}
+
+	//enter - w.size() - 1 values
+	double scalar_product(const double* enter, const bool& correct_summation, double* buffer = nullptr) const
 	{
 		double sum;
+		const double* const enter_end = enter + (w.size() - 1);
 
 		if (correct_summation == false)
 		{
-			sum = inner_product(enter.cbegin(), enter.cend(), w.cbegin(), 0.0); ////w[0]*enter[0] + w[1]*enter[1] + ...
+			sum = inner_product(enter, enter_end, w.cbegin(), 0.0); ////w[0]*enter[0] + w[1]*enter[1] + ...
 			sum += -w.back();
 		}
 		else //before summing a large array of small numbers for accuracy they are sorted
 		{
-			vector <double> for_sum(w.size());
-			transform(enter.cbegin(), enter.cend(), w.cbegin(), for_sum.begin(), [](const double& a, const double& b) {return a * b; }); //for_sum[i] = enter[i] * w[i]
-			for_sum.back() = -w.back(); // for_sum[N_w - 1] =  - 1 * w[N_w - 1]
-			sort(for_sum.begin(), for_sum.end(), f_abs_sort);
-			sum = accumulate(for_sum.cbegin(), for_sum.cend(), 0.0);
+			vector <double> memory_for_sum;
+			if (buffer == nullptr)
+			{
+				memory_for_sum.resize(w.size());
+				buffer = memory_for_sum.data();
+			}
+			double* const for_sum = buffer;
+			const size_t N_w = w.size();
+			transform(enter, enter_end, w.cbegin(), for_sum, [](const double& a, const double& b) {return a * b; }); //for_sum[i] = enter[i] * w[i]
+			for_sum[N_w - 1] = -w.back(); // for_sum[N_w - 1] =  - 1 * w[N_w - 1]
+			sort(for_sum, for_sum + N_w, f_abs_sort);
+			sum = accumulate(for_sum, for_sum + N_w, 0.0);
 		}
 		return sum;
 	}
@@ -0,0 +1,310 @@
+//Copyright[2019][Gaganov Ilya]
+//Licensed under the Apache License, Version 2.0
+
+#pragma once
+
+#include "train_data.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <functional>
+#include <omp.h>
+
+#ifdef __linux__
+#include <sched.h>
+#include <dirent.h>
+#endif
+
+using namespace std;
+
+//the nodes of memory and their processors read from /sys/devices/system/node (Linux),
+//only the processors allowed to the process are used; on other systems - one node with all processors
+class numa_topology
+{
+public:
+	numa_topology()
+	{
+		discover();
+	}
+
+	//the topology of the machine, read once
+	static const numa_topology& get()
+	{
+		static const numa_topology topology;
+		return topology;
+	}
+
+	size_t get_n_nodes() const
+	{
+		return nodes.size();
+	}
+
+	const vector <int>& get_cpus(const size_t &node) const
+	{
+		return nodes[node];
+	}
+
+	size_t get_n_cpus() const
+	{
+		size_t res = 0;
+		for (size_t i = 0; i < nodes.size(); ++i)
+			res += nodes[i].size();
+		return res;
+	}
+
+	size_t get_node_of_cpu(const int &cpu) const
+	{
+		return (cpu >= 0 && static_cast<size_t>(cpu) < node_of_cpu.size()) ? node_of_cpu[cpu] : 0;
+	}
+
+	//the node of the processor running the calling thread
+	size_t get_current_node() const
+	{
+#ifdef __linux__
+		if (nodes.size() > 1)
+			return get_node_of_cpu(sched_getcpu());
+#endif
+		return 0;
+	}
+
+	//the processor of the thread number thread: "compact" - the processors of node 0, then of node 1 ...,
+	//"scatter" - the nodes in turn, so the threads and the bandwidth of memory are divided between the nodes
+	int get_cpu_for_thread(const size_t &thread, const string &policy) const
+	{
+		if (policy == "scatter")
+		{
+			const size_t node = thread % nodes.size();
+			return nodes[node][(thread / nodes.size()) % nodes[node].size()];
+		}
+		size_t k = thread % get_n_cpus();
+		size_t node = 0;
+		while (k >= nodes[node].size())
+			k -= nodes[node++].size();
+		return nodes[node][k];
+	}
+
+	void print() const
+	{
+		cout << "numa nodes = " << nodes.size() << endl;
+		for (size_t i = 0; i < nodes.size(); ++i)
+		{
+			cout << "  node " << i << ": cpus =";
+			for (size_t j = 0; j < nodes[i].size(); ++j)
+				cout << " " << nodes[i][j];
+			cout << endl;
+		}
+	}
+
+	//"0-3,8,10-11" -> 0 1 2 3 8 10 11
+	static vector <int> parse_cpulist(const string &text)
+	{
+		vector <int> res;
+		stringstream stream(text);
+		string range;
+		while (getline(stream, range, ','))
+		{
+			const size_t dash = range.find('-');
+			const int first = atoi(range.c_str());
+			const int last = (dash == string::npos) ? first : atoi(range.c_str() + dash + 1);
+			if (range.find_first_of("0123456789") == string::npos)
+				continue;
+			for (int cpu = first; cpu <= last; ++cpu)
+				res.push_back(cpu);
+		}
+		return res;
+	}
+
+private:
+	void discover()
+	{
+#ifdef __linux__
+		cpu_set_t allowed;
+		CPU_ZERO(&allowed);
+		const bool has_mask = (sched_getaffinity(0, sizeof(allowed), &allowed) == 0);
+
+		DIR* const dir = opendir("/sys/devices/system/node");
+		if (dir != nullptr)
+		{
+			vector <pair<int, vector<int>>> found;
+			while (dirent* const entry = readdir(dir))
+			{
+				const string name = entry->d_name;
+				if (name.compare(0, 4, "node") != 0 || name.size() == 4 || isdigit(static_cast<unsigned char>(name[4])) == 0)
+					continue;
+				ifstream file("/sys/devices/system/node/" + name + "/cpulist");
+				string text;
+				getline(file, text);
+				vector <int> cpus;
+				const vector <int> listed = parse_cpulist(text);
+				for (size_t i = 0; i < listed.size(); ++i)
+					if (has_mask == false || (listed[i] < CPU_SETSIZE && CPU_ISSET(listed[i], &allowed)))
+						cpus.push_back(listed[i]);
+				if (cpus.size() != 0)
+					found.push_back(make_pair(atoi(name.c_str() + 4), cpus));
+			}
+			closedir(dir);
+			sort(found.begin(), found.end());
+			for (size_t i = 0; i < found.size(); ++i)
+				nodes.push_back(found[i].second);
+		}
+		if (nodes.size() == 0 && has_mask == true)
+		{
+			nodes.push_back(vector<int>());
+			for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+				if (CPU_ISSET(cpu, &allowed))
+					nodes[0].push_back(cpu);
+		}
+#endif
+		if (nodes.size() == 0 || nodes[0].size() == 0)
+		{
+			nodes.assign(1, vector<int>());
+			for (int cpu = 0; cpu < static_cast<int>(max(thread::hardware_concurrency(), 1u)); ++cpu)
+				nodes[0].push_back(cpu);
+		}
+		for (size_t i = 0; i < nodes.size(); ++i)
+			for (size_t j = 0; j < nodes[i].size(); ++j)
+			{
+				if (static_cast<size_t>(nodes[i][j]) >= node_of_cpu.size())
+					node_of_cpu.resize(nodes[i][j] + 1, 0);
+				node_of_cpu[nodes[i][j]] = i;
+			}
+	}
+
+	vector <vector<int>> nodes; //the processors of each node
+	vector <size_t> node_of_cpu;
+};
+
+//the calling thread runs only on the processor cpu, returns false if it is not supported
+inline bool pin_thread_to_cpu(const int &cpu)
+{
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+	return false;
+#endif
+}
+
+//the calling thread runs on any processor of the node
+inline bool pin_thread_to_node(const size_t &node)
+{
+#ifdef __linux__
+	const vector <int> &cpus = numa_topology::get().get_cpus(node);
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (size_t i = 0; i < cpus.size(); ++i)
+		CPU_SET(cpus[i], &set);
+	return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+	return false;
+#endif
+}
+
+//the processors allowed to the calling thread, kept to be restored after pinning
+class thread_affinity
+{
+public:
+	bool save()
+	{
+#ifdef __linux__
+		CPU_ZERO(&mask);
+		saved = (sched_getaffinity(0, sizeof(mask), &mask) == 0);
+#endif
+		return saved;
+	}
+
+	//the calling thread gets the saved processors
+	bool restore() const
+	{
+#ifdef __linux__
+		if (saved == true)
+			return sched_setaffinity(0, sizeof(mask), &mask) == 0;
+#endif
+		return false;
+	}
+
+private:
+#ifdef __linux__
+	cpu_set_t mask;
+#endif
+	bool saved = false;
+};
+
+//pinning the threads of the OpenMP team of n_threads threads while the object exists, the runtime keeps the same threads
+//for the next parallel regions of the same size; the thread 0 is the calling thread, so the processors of each thread
+//are restored by the destructor and the threads started later are not limited to one processor;
+//policy "compact" or "scatter", see numa_topology::get_cpu_for_thread, "none" - nothing is done
+class pinned_threads
+{
+public:
+	pinned_threads(const size_t &new_n_threads, const string &policy) : n_threads(max(new_n_threads, static_cast<size_t>(1)))
+	{
+		if (policy == "none" || policy == "")
+			return;
+		const numa_topology &topology = numa_topology::get();
+		affinity.resize(n_threads);
+#pragma omp parallel num_threads(n_threads)
+		{
+			const size_t thread = omp_get_thread_num();
+			if (affinity[thread].save() == true)
+				pin_thread_to_cpu(topology.get_cpu_for_thread(thread, policy));
+		}
+	}
+
+	~pinned_threads()
+	{
+		if (affinity.size() == 0)
+			return;
+#pragma omp parallel num_threads(n_threads)
+		affinity[omp_get_thread_num()].restore();
+	}
+
+	pinned_threads(const pinned_threads &) = delete;
+	pinned_threads& operator= (const pinned_threads &) = delete;
+
+private:
+	const size_t n_threads;
+	vector <thread_affinity> affinity; //of each thread of the team, empty - nothing was pinned
+};
+
+//the function is run by a new thread pinned to the node, so the memory it fills first is placed on the node
+inline void run_on_node(const size_t &node, const function<void()> &f)
+{
+	thread t([&]()
+	{
+		pin_thread_to_node(node);
+		f();
+	});
+	t.join();
+}
+
+//the copy of all examples (not only of the pointers) made in the calling thread
+inline train_data copy_train_data(const train_data &data)
+{
+	train_data res;
+	res.reserve(data.size());
+	for (size_t i = 0; i < data.size(); ++i)
+		res.add_data(*data[i]);
+	return res;
+}
+
+//the examples i, i + n_nodes, ... copied into the memory of the node i
+inline vector <train_data> split_by_nodes(const train_data &data)
+{
+	const size_t n_nodes = numa_topology::get().get_n_nodes();
+	vector <train_data> res(n_nodes);
+	for (size_t node = 0; node < n_nodes; ++node)
+		run_on_node(node, [&]()
+		{
+			res[node].reserve(data.size() / n_nodes + 1);
+			for (size_t i = node; i < data.size(); i += n_nodes)
+				res[node].add_data(*data[i]);
+		});
+	return res;
+}
\ No newline at end of file
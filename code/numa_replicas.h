@@ -0,0 +1,64 @@
+//Copyright[2019][Gaganov Ilya]
+//Licensed under the Apache License, Version 2.0
+
+#pragma once
+
+#include "foxnn.h"
+#include "numa.h"
+#include <iostream>
+#include <vector>
+#include <memory>
+
+using namespace std;
+
+//a copy of the weights in the memory of each node for inference on machines with several nodes:
+//a thread reads the weights of the node it is running on instead of going to the memory of another node;
+//on one node there is one copy, update must not be called at the same time as get_out
+class numa_replicas
+{
+public:
+	numa_replicas(const neural_network &nn)
+	{
+		update(nn);
+	}
+
+	//the copies are made by threads pinned to their nodes, so the weights are first touched there
+	void update(const neural_network &nn)
+	{
+		const size_t n_nodes = numa_topology::get().get_n_nodes();
+		replicas.resize(n_nodes);
+		for (size_t node = 0; node < n_nodes; ++node)
+			run_on_node(node, [&]()
+			{
+				replicas[node] = make_shared<neural_network>(nn, false);
+			});
+	}
+
+	vector<double> get_out(const vector<double> &first_in) const
+	{
+		return get_local().get_out(first_in);
+	}
+
+	bool get_out_batch(const double* in, size_t N_rows_in, size_t N_cols_in, double* out, size_t N_rows_out, size_t N_cols_out) const
+	{
+		return get_local().get_out_batch(in, N_rows_in, N_cols_in, out, N_rows_out, N_cols_out);
+	}
+
+	const neural_network& get_replica(const size_t &node) const
+	{
+		return *replicas[node];
+	}
+
+	size_t get_n_replicas() const
+	{
+		return replicas.size();
+	}
+
+private:
+	const neural_network& get_local() const
+	{
+		return *replicas[numa_topology::get().get_current_node() % replicas.size()];
+	}
+
+	vector <shared_ptr<neural_network>> replicas;
+};
\ No newline at end of file
@@ -0,0 +1,237 @@
+//Copyright[2019][Gaganov Ilya]
+//Licensed under the Apache License, Version 2.0
+
+#pragma once
+
+#include "foxnn.h"
+#include "model_handle.h"
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <omp.h>
+
+using namespace std;
+
+//training on a stream of examples: the memory for training and the state of the optimizer are created once
+//and kept between the calls, so one call of learn costs only the forward and backward pass of its examples;
+//the network must not be used by other threads during the session, the readers take the published copies from model_handle
+class online_session
+{
+public:
+	//max_batch - the largest number of examples in one step, the longer batches are split
+	online_session(neural_network &new_network, const double &new_speed, const size_t &new_max_batch = 32) :
+		network(new_network), speed(new_speed), max_batch(max(new_max_batch, static_cast<size_t>(1))), n_threads(network.settings.n_threads),
+		handle(nullptr), n_samples_publish(0), seconds_publish(0.0), n_samples(0), n_steps(0), n_published(0),
+		n_samples_last_publish(0), time_last_publish(0.0), time_total(0.0), time_max(0.0), finished(false)
+	{
+		network.init_online_train(max_batch);
+
+		//batches[k] - the first k + 1 examples, the examples are overwritten by each step
+		samples.reserve(max_batch);
+		batches.reserve(max_batch);
+		vector <shared_ptr<const one_train_data>> first;
+		for (size_t i = 0; i < max_batch; ++i)
+		{
+			samples.push_back(make_shared<one_train_data>());
+			first.push_back(samples.back());
+			vector <shared_ptr<const one_train_data>> part(first);
+			batches.push_back(train_data(part));
+		}
+	}
+
+	~online_session()
+	{
+		finish();
+	}
+
+	//one step on one example
+	bool learn(const vector<double> &input, const vector<double> &target)
+	{
+		if (check(input.size(), target.size()) == false)
+			return false;
+		samples[0]->input.assign(input.cbegin(), input.cend());
+		samples[0]->out.assign(target.cbegin(), target.cend());
+		step(1);
+		return true;
+	}
+
+	//steps on the examples in order, max_batch examples in each step
+	bool learn_batch(const train_data &data)
+	{
+		for (size_t i = 0; i < data.size(); ++i)
+			if (check(data[i]->input.size(), data[i]->out.size()) == false)
+				return false;
+		for (size_t begin = 0; begin < data.size(); begin += max_batch)
+		{
+			const size_t N = min(max_batch, data.size() - begin);
+			for (size_t i = 0; i < N; ++i)
+			{
+				samples[i]->input.assign(data[begin + i]->input.cbegin(), data[begin + i]->input.cend());
+				samples[i]->out.assign(data[begin + i]->out.cbegin(), data[begin + i]->out.cend());
+			}
+			step(N);
+		}
+		return true;
+	}
+
+	//the same for arrays: N_rows_in x N_cols_in inputs and N_rows_target x N_cols_target target values (for NumPy arrays in Python)
+	bool learn_batch(const double* in, size_t N_rows_in, size_t N_cols_in, const double* target, size_t N_rows_target, size_t N_cols_target)
+	{
+		if (N_rows_in != N_rows_target)
+		{
+			cout << "the number of inputs and target values does not match" << endl;
+			return false;
+		}
+		if (check(N_cols_in, N_cols_target) == false)
+			return false;
+		for (size_t begin = 0; begin < N_rows_in; begin += max_batch)
+		{
+			const size_t N = min(max_batch, N_rows_in - begin);
+			for (size_t i = 0; i < N; ++i)
+			{
+				samples[i]->input.assign(in + (begin + i) * N_cols_in, in + (begin + i + 1) * N_cols_in);
+				samples[i]->out.assign(target + (begin + i) * N_cols_target, target + (begin + i + 1) * N_cols_target);
+			}
+			step(N);
+		}
+		return true;
+	}
+
+	//the copy of the weights is published to the handle after every n_samples examples and (or) after seconds of learning,
+	//0 - the condition is not used; copying costs O(number of weights) in the thread of learn
+	void set_publish(model_handle &new_handle, const size_t &new_n_samples_publish = 1, const double &new_seconds_publish = 0.0)
+	{
+		handle = &new_handle;
+		n_samples_publish = new_n_samples_publish;
+		seconds_publish = new_seconds_publish;
+		n_samples_last_publish = n_samples;
+		time_last_publish = omp_get_wtime();
+	}
+
+	//publishing the current weights now
+	void publish()
+	{
+		if (handle == nullptr)
+			return;
+		handle->publish(get_copy());
+		n_published++;
+		n_samples_last_publish = n_samples;
+		time_last_publish = omp_get_wtime();
+	}
+
+	//a copy of the weights without the memory for training
+	neural_network get_copy() const
+	{
+		return neural_network(network, false);
+	}
+
+	//the memory for training is freed, the network may be used as usual
+	void finish()
+	{
+		if (finished == true)
+			return;
+		if (handle != nullptr && n_samples != n_samples_last_publish)
+			publish();
+		network.delete_memory_after_train();
+		finished = true;
+	}
+
+	void set_speed(const double &new_speed)
+	{
+		speed = new_speed;
+	}
+
+	size_t get_n_samples() const
+	{
+		return n_samples;
+	}
+
+	size_t get_n_steps() const
+	{
+		return n_steps;
+	}
+
+	size_t get_n_published() const
+	{
+		return n_published;
+	}
+
+	//the time of one step in microseconds, with publishing
+	double get_mean_latency_us() const
+	{
+		return (n_steps == 0) ? 0.0 : 1e6 * time_total / n_steps;
+	}
+
+	double get_max_latency_us() const
+	{
+		return 1e6 * time_max;
+	}
+
+	void print_stats() const
+	{
+		cout << "online: samples = " << n_samples << " steps = " << n_steps << " published = " << n_published
+			<< " latency us: mean = " << get_mean_latency_us() << " max = " << get_max_latency_us() << endl;
+	}
+
+private:
+	bool check(const size_t &N_in, const size_t &N_out) const
+	{
+		if (finished == true)
+		{
+			cout << "the session is finished" << endl;
+			return false;
+		}
+		if (N_in != network.get_N_in() || N_out != network.get_N_out())
+		{
+			cout << "the size of the example does not match the network" << endl;
+			return false;
+		}
+		if (network.settings.n_threads != n_threads)
+		{
+			cout << "n_threads must not be changed during the session" << endl;
+			return false;
+		}
+		return true;
+	}
+
+	void step(const size_t &N)
+	{
+		const double time_start = omp_get_wtime();
+		//a copy made by clone shares the layers
+		for (size_t i = 0; i < network.layers.size(); ++i)
+			network.make_layer_unique_for_train(i, max_batch);
+		network.train_nn(batches[N - 1], speed);
+		n_samples += N;
+		n_steps++;
+
+		if (handle != nullptr)
+		{
+			const double now = omp_get_wtime();
+			if ((n_samples_publish != 0 && n_samples - n_samples_last_publish >= n_samples_publish) ||
+				(seconds_publish > 0.0 && now - time_last_publish >= seconds_publish))
+				publish();
+		}
+		const double time = omp_get_wtime() - time_start;
+		time_total += time;
+		time_max = max(time_max, time);
+	}
+
+	neural_network &network;
+	double speed;
+	const size_t max_batch;
+	const size_t n_threads;
+	vector <shared_ptr<one_train_data>> samples;
+	vector <train_data> batches;
+	model_handle* handle;
+	size_t n_samples_publish;
+	double seconds_publish;
+	size_t n_samples;
+	size_t n_steps;
+	size_t n_published;
+	size_t n_samples_last_publish;
+	double time_last_publish;
+	double time_total;
+	double time_max;
+	bool finished;
+};
\ No newline at end of file
@@ -15,6 +15,9 @@ public:
 
 	virtual void correction_of_scales(double &w, const double& speed, const Settings& settings) = 0;
 
+	//the size of the object for the accounting of memory
+	virtual size_t get_size() const = 0;
+
 	double derivative;
 };
 
@@ -50,6 +53,11 @@ public:
 			w -= res;
 	}
 
+	size_t get_size() const
+	{
+		return sizeof(*this);
+	}
+
 private:
 	double m;
 	double v;
@@ -66,6 +74,11 @@ public:
 		w -= v;
 	}
 
+	size_t get_size() const
+	{
+		return sizeof(*this);
+	}
+
 	double v;
 };
 
@@ -77,6 +90,11 @@ public:
 	{
 		w -= speed * derivative;
 	}
+
+	size_t get_size() const
+	{
+		return sizeof(*this);
+	}
 };
 
 shared_ptr<base_class_optimization> get_optimization(const string &mode)
@@ -0,0 +1,213 @@
+//Copyright[2019][Gaganov Ilya]
+//Licensed under the Apache License, Version 2.0
+
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+#include <numeric>
+#include <omp.h>
+
+using namespace std;
+
+//with #define FOXNN_NO_PROFILING before including the library all profiling code is removed by the compiler
+#ifdef FOXNN_NO_PROFILING
+const bool profiling_compiled = false;
+#else
+const bool profiling_compiled = true;
+#endif
+
+//the time (in seconds summed over threads) and the number of floating point operations of one layer
+class layer_profile
+{
+public:
+	layer_profile() : time_forward(0), time_backward(0), time_update(0), flop_forward(0), flop_backward(0), flop_update(0) {}
+
+	double get_gflops_forward() const
+	{
+		return gflops(flop_forward, time_forward);
+	}
+
+	double get_gflops_backward() const
+	{
+		return gflops(flop_backward, time_backward);
+	}
+
+	double get_gflops_update() const
+	{
+		return gflops(flop_update, time_update);
+	}
+
+	double time_forward;
+	double time_backward;
+	double time_update;
+	double flop_forward;
+	double flop_backward;
+	double flop_update;
+
+private:
+	static double gflops(const double &flop, const double &time)
+	{
+		return (time > 0) ? flop / time / 1e9 : 0.0;
+	}
+};
+
+//the result of profiling of training
+class profile_info
+{
+public:
+	profile_info() : time_train(0), time_sampling(0), time_testing(0), time_save(0), n_iterations(0), n_samples(0), n_allocations(0) {}
+
+	double get_samples_per_second() const
+	{
+		return (time_train > 0) ? n_samples / time_train : 0.0;
+	}
+
+	//time of the optimizer (correction of the weights) of all layers
+	double get_time_update() const
+	{
+		double res = 0.0;
+		for (size_t i = 0; i < layers.size(); ++i)
+			res += layers[i].time_update;
+		return res;
+	}
+
+	//all values by names (for Python)
+	map <string, double> to_map() const
+	{
+		map <string, double> res;
+		res["time_train"] = time_train;
+		res["time_sampling"] = time_sampling;
+		res["time_testing"] = time_testing;
+		res["time_save"] = time_save;
+		res["time_update"] = get_time_update();
+		res["n_iterations"] = static_cast<double>(n_iterations);
+		res["n_samples"] = static_cast<double>(n_samples);
+		res["n_allocations"] = static_cast<double>(n_allocations);
+		res["samples_per_second"] = get_samples_per_second();
+		for (size_t i = 0; i < layers.size(); ++i)
+		{
+			const string name = "layer_" + to_string(i) + "_";
+			res[name + "time_forward"] = layers[i].time_forward;
+			res[name + "time_backward"] = layers[i].time_backward;
+			res[name + "time_update"] = layers[i].time_update;
+			res[name + "flop_forward"] = layers[i].flop_forward;
+			res[name + "flop_backward"] = layers[i].flop_backward;
+			res[name + "flop_update"] = layers[i].flop_update;
+			res[name + "gflops_forward"] = layers[i].get_gflops_forward();
+			res[name + "gflops_backward"] = layers[i].get_gflops_backward();
+			res[name + "gflops_update"] = layers[i].get_gflops_update();
+		}
+		return res;
+	}
+
+	void print() const
+	{
+		cout << "profile: time_train = " << time_train << " time_sampling = " << time_sampling << " time_update = " << get_time_update()
+			<< " time_testing = " << time_testing << " time_save = " << time_save << endl;
+		cout << "n_iterations = " << n_iterations << " n_samples = " << n_samples << " samples_per_second = " << get_samples_per_second()
+			<< " n_allocations = " << n_allocations << endl;
+		for (size_t i = 0; i < layers.size(); ++i)
+			cout << "layer " << i << " forward: " << layers[i].time_forward << " s " << layers[i].get_gflops_forward() << " GFLOP/s"
+				<< " backward: " << layers[i].time_backward << " s " << layers[i].get_gflops_backward() << " GFLOP/s"
+				<< " update: " << layers[i].time_update << " s " << layers[i].get_gflops_update() << " GFLOP/s" << endl;
+	}
+
+	vector <layer_profile> layers;
+	double time_train; //wall time of the training iterations (forward, backward and update)
+	double time_sampling; //wall time of taking batches from the training data
+	double time_testing; //wall time of testing during training
+	double time_save; //wall time of auto_save
+	size_t n_iterations;
+	size_t n_samples;
+	size_t n_allocations; //allocations of the workspaces during training
+};
+
+//counters of profiling: each thread adds the time of layers to its own row, the rows are summed on request
+class profiler
+{
+public:
+	profiler() {}
+
+	//preparation for the network with N_weights[i] weights in the layer i and n_threads threads
+	void init(const vector <size_t> &N_weights, const size_t &n_threads)
+	{
+		const size_t N_layers = N_weights.size();
+		N_weights_layers = N_weights;
+		if (info.layers.size() != N_layers || counters.size() < n_threads)
+		{
+			get();
+			if (info.layers.size() != N_layers)
+			{
+				info = profile_info();
+				info.layers.resize(N_layers);
+			}
+			counters.assign(max(n_threads, counters.size()), vector <double>(N_layers * size_row + padding, 0.0));
+		}
+	}
+
+	void add_forward(const size_t &thread, const size_t &num_layer, const double &time)
+	{
+		counters[thread][num_layer * size_row] += time;
+	}
+
+	void add_backward(const size_t &thread, const size_t &num_layer, const double &time)
+	{
+		counters[thread][num_layer * size_row + 1] += time;
+	}
+
+	void add_update(const size_t &thread, const size_t &num_layer, const double &time)
+	{
+		counters[thread][num_layer * size_row + 2] += time;
+	}
+
+	//operations of the iteration on a batch of size_batch examples
+	void add_iteration(const size_t &size_batch)
+	{
+		info.n_iterations++;
+		info.n_samples += size_batch;
+		for (size_t i = 0; i < info.layers.size(); ++i)
+		{
+			const double N_w = static_cast<double>(N_weights_layers[i]);
+			info.layers[i].flop_forward += 2.0 * N_w * size_batch;
+			info.layers[i].flop_backward += 6.0 * N_w * size_batch; //the derivative, the error of the previous layer and the momentum
+			info.layers[i].flop_update += 2.0 * N_w;
+		}
+	}
+
+	//the summed result, the counters of the threads are transferred to info
+	profile_info get()
+	{
+		for (size_t t = 0; t < counters.size(); ++t)
+		{
+			for (size_t i = 0; i < info.layers.size(); ++i)
+			{
+				info.layers[i].time_forward += counters[t][i * size_row];
+				info.layers[i].time_backward += counters[t][i * size_row + 1];
+				info.layers[i].time_update += counters[t][i * size_row + 2];
+			}
+			fill(counters[t].begin(), counters[t].end(), 0.0);
+		}
+		return info;
+	}
+
+	void reset()
+	{
+		const size_t N_layers = info.layers.size();
+		info = profile_info();
+		info.layers.resize(N_layers);
+		for (size_t t = 0; t < counters.size(); ++t)
+			fill(counters[t].begin(), counters[t].end(), 0.0);
+	}
+
+	profile_info info;
+
+private:
+	static const size_t size_row = 3; //forward, backward, update
+	static const size_t padding = 8; //the rows of different threads do not share a cache line
+	vector <vector <double>> counters;
+	vector <size_t> N_weights_layers;
+};
\ No newline at end of file
@@ -0,0 +1,207 @@
+//Copyright[2019][Gaganov Ilya]
+//Licensed under the Apache License, Version 2.0
+
+#pragma once
+
+#include <random>
+#include <cmath>
+#include <cstdint>
+#include <atomic>
+#include <omp.h>
+
+using namespace std;
+
+//step of the splitmix64 generator, used to get independent seeds and as a counter-based generator
+inline uint64_t splitmix64(uint64_t x)
+{
+	x += 0x9E3779B97F4A7C15ull;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+	return x ^ (x >> 31);
+}
+
+//uniform value in [0, 1) from 53 high bits
+inline double to_uniform_double(const uint64_t &x)
+{
+	return (x >> 11) * (1.0 / 9007199254740992.0);
+}
+
+//generator xoshiro256**, can be used with the distributions from <random>
+class random_generator
+{
+public:
+	typedef uint64_t result_type;
+
+	random_generator(const uint64_t &seed = 0)
+	{
+		set_seed(seed);
+	}
+
+	void set_seed(uint64_t seed)
+	{
+		for (size_t i = 0; i < 4; ++i)
+		{
+			seed = splitmix64(seed);
+			s[i] = seed;
+		}
+	}
+
+	static constexpr result_type min()
+	{
+		return 0;
+	}
+
+	static constexpr result_type max()
+	{
+		return UINT64_MAX;
+	}
+
+	result_type operator()()
+	{
+		const uint64_t res = rotl(s[1] * 5, 7) * 9;
+		const uint64_t t = s[1] << 17;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = rotl(s[3], 45);
+		return res;
+	}
+
+	//uniform value in [a, b)
+	double uniform(const double &a = 0.0, const double &b = 1.0)
+	{
+		return a + (b - a) * to_uniform_double((*this)());
+	}
+
+	//uniform integer in [0, n)
+	size_t uniform_int(const size_t &n)
+	{
+		const size_t res = static_cast<size_t>(to_uniform_double((*this)()) * n);
+		return (res < n) ? res : n - 1;
+	}
+
+	double normal(const double &mean = 0.0, const double &sigma = 1.0)
+	{
+		const double u1 = 1.0 - to_uniform_double((*this)()); //(0, 1]
+		const double u2 = to_uniform_double((*this)());
+		return mean + sigma * sqrt(-2.0 * log(u1)) * cos(two_pi * u2);
+	}
+
+	//filling res[0..n) with uniform values in [a, b)
+	//one step of the generator gives the key, the values are counted independently of each other (counter-based),
+	//so the loop is vectorized
+	void uniform(double* res, const size_t &n, const double &a = 0.0, const double &b = 1.0)
+	{
+		const uint64_t key = (*this)();
+		const double scale = b - a;
+#pragma omp simd
+		for (size_t i = 0; i < n; ++i)
+			res[i] = a + scale * to_uniform_double(splitmix64(key + i * 0xD1B54A32D192ED03ull));
+	}
+
+	//filling res[0..n) with normal values (Box-Muller transform)
+	void normal(double* res, const size_t &n, const double &mean = 0.0, const double &sigma = 1.0)
+	{
+		const uint64_t key = (*this)();
+		const size_t n_pairs = n / 2;
+#pragma omp simd
+		for (size_t i = 0; i < n_pairs; ++i)
+		{
+			const double u1 = 1.0 - to_uniform_double(splitmix64(key + (2 * i) * 0xD1B54A32D192ED03ull));
+			const double u2 = to_uniform_double(splitmix64(key + (2 * i + 1) * 0xD1B54A32D192ED03ull));
+			const double r = sigma * sqrt(-2.0 * log(u1));
+			res[2 * i] = mean + r * cos(two_pi * u2);
+			res[2 * i + 1] = mean + r * sin(two_pi * u2);
+		}
+		if (n % 2 == 1)
+			res[n - 1] = normal(mean, sigma);
+	}
+
+private:
+	static constexpr double two_pi = 6.283185307179586476925;
+
+	static uint64_t rotl(const uint64_t &x, const int &k)
+	{
+		return (x << k) | (x >> (64 - k));
+	}
+
+	uint64_t s[4];
+};
+
+//the common seed of the generators of all threads, 0 - the seed is taken from random_device
+class random_seed
+{
+public:
+	static void set(const uint64_t &seed)
+	{
+		value() = seed;
+		n_streams() = 0;
+		generation()++; //the generators of the threads will be created again
+	}
+
+	static uint64_t get()
+	{
+		return value();
+	}
+
+private:
+	friend random_generator& get_random_generator();
+
+	static atomic <uint64_t>& value()
+	{
+		static atomic <uint64_t> seed(0);
+		return seed;
+	}
+
+	static atomic <uint64_t>& generation()
+	{
+		static atomic <uint64_t> n(0);
+		return n;
+	}
+
+	//the threads outside of the OpenMP teams which have created their generators since the last set
+	static atomic <uint64_t>& n_streams()
+	{
+		static atomic <uint64_t> n(0);
+		return n;
+	}
+};
+
+//the generator of the calling thread
+//with a given seed the stream of a thread of an OpenMP team (not the thread 0) depends only on the seed and omp_get_thread_num(),
+//the other threads (the main thread, std::thread, the thread 0 of a team) are numbered in the order of their first use since
+//random_seed::set, in a separate range, so all threads get different streams; the results are reproducible for the same seed
+//and number of threads if the threads outside of the teams use the generator in the same order
+random_generator& get_random_generator()
+{
+	thread_local random_generator gen;
+	thread_local uint64_t generation = UINT64_MAX;
+
+	const uint64_t now_generation = random_seed::generation();
+	if (generation != now_generation)
+	{
+		generation = now_generation;
+		const uint64_t seed = random_seed::get();
+		if (seed == 0)
+		{
+			random_device rd; //one access to the entropy source per thread
+			gen.set_seed((static_cast<uint64_t>(rd()) << 32) ^ rd());
+		}
+		else
+		{
+			//the first thread outside of the teams gets the stream 1, as the thread 0 of a team
+			uint64_t stream = 0;
+			if (omp_get_level() > 0 && omp_get_thread_num() != 0)
+				stream = omp_get_thread_num() + 1;
+			else
+			{
+				const uint64_t n = random_seed::n_streams()++;
+				stream = (n == 0) ? 1 : (static_cast<uint64_t>(1) << 32) + n;
+			}
+			gen.set_seed(splitmix64(seed) ^ splitmix64(stream));
+		}
+	}
+	return gen;
+}
\ No newline at end of file
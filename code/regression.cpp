@@ -0,0 +1,46 @@
+//Copyright[2019][Gaganov Ilya]
+//Licensed under the Apache License, Version 2.0
+
+//comparison with the baseline: make check_regression (or g++ -std=c++11 -O2 -fopenmp regression.cpp -o regression)
+//usage: regression name_file_baseline [name_file_result] [tolerance] [min_time]
+//the threads are pinned to the cores only if OMP_PROC_BIND=true and OMP_PLACES=cores are exported before the start,
+//the runtime of OpenMP reads them when the program is loaded; make check_regression sets them
+//if the baseline does not exist, the results are saved as the baseline
+//exit code: 0 - no regressions, 1 - there are regressions, 2 - error
+
+#include <cstdlib>
+#include "regression.h"
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		cout << "usage: regression name_file_baseline [name_file_result] [tolerance] [min_time]" << endl;
+		return 2;
+	}
+	const string name_file_baseline = argv[1];
+	const string name_file_result = (argc > 2) ? argv[2] : "benchmark_result.json";
+	regression_gate gate;
+	if (argc > 3)
+		gate.tolerance = atof(argv[3]);
+
+	benchmark b;
+	if (argc > 4)
+		b.min_time = atof(argv[4]);
+	regression_gate::run_fixed(b);
+	if (b.save_json(name_file_result) == false)
+		return 2;
+
+	if (ifstream(name_file_baseline).good() == false)
+	{
+		cout << "no baseline, the results are saved to " << name_file_baseline << endl;
+		return (b.save_json(name_file_baseline) == true) ? 0 : 2;
+	}
+	vector <benchmark_result> baseline;
+	if (regression_gate::load_json(name_file_baseline, baseline) == false)
+		return 2;
+
+	const vector <benchmark_comparison> comparisons = gate.compare(baseline, b.results);
+	regression_gate::print(comparisons);
+	return (regression_gate::get_n_regressions(comparisons) == 0) ? 0 : 1;
+}
\ No newline at end of file
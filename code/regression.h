@@ -0,0 +1,240 @@
+//Copyright[2019][Gaganov Ilya]
+//Licensed under the Apache License, Version 2.0
+
+#pragma once
+
+#include "benchmark.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <cmath>
+#include <algorithm>
+#include <cctype>
+
+using namespace std;
+
+//the change of one case relative to the baseline, delta > 0 - slower
+class benchmark_comparison
+{
+public:
+	benchmark_comparison() : baseline(0.0), current(0.0), delta(0.0), noise(0.0), regression(false), improvement(false) {}
+
+	string key;
+	double baseline; //ns per operation, the median
+	double current;
+	double delta; //current / baseline - 1
+	double noise; //n_mad combined deviations of both runs, ns per operation
+	bool regression;
+	bool improvement;
+};
+
+//comparison of the results of the fixed benchmark set with the stored baseline:
+//a case is a regression if it is slower by more than tolerance and the difference is above the noise of the repeats
+class regression_gate
+{
+public:
+	regression_gate() : tolerance(0.1), n_mad(3.0) {}
+
+	//the fixed set: the same seed, topologies, batches and one thread on every run
+	static void run_fixed(benchmark &b)
+	{
+		Settings::set_seed(1);
+		b.sizes = { 64, 256 };
+		b.topologies = { {32, 64, 4}, {256, 128, 10} };
+		b.batches = { 1, 32 };
+		b.threads = { 1 };
+		b.n_repeats = max(b.n_repeats, static_cast<size_t>(7));
+		b.run_all();
+	}
+
+	vector <benchmark_comparison> compare(const vector <benchmark_result> &baseline, const vector <benchmark_result> &current) const
+	{
+		map <string, const benchmark_result*> base;
+		for (size_t i = 0; i < baseline.size(); ++i)
+			base[get_key(baseline[i])] = &baseline[i];
+
+		vector <benchmark_comparison> res;
+		for (size_t i = 0; i < current.size(); ++i)
+		{
+			const string key = get_key(current[i]);
+			auto it = base.find(key);
+			if (it == base.end() || it->second->ns_per_op <= 0.0)
+				continue;
+
+			benchmark_comparison c;
+			c.key = key;
+			c.baseline = it->second->ns_per_op;
+			c.current = current[i].ns_per_op;
+			c.delta = c.current / c.baseline - 1.0;
+			c.noise = n_mad * sqrt(pow(get_mad(it->second->runs), 2) + pow(get_mad(current[i].runs), 2));
+			c.regression = (c.delta > tolerance && c.current - c.baseline > c.noise);
+			c.improvement = (-c.delta > tolerance && c.baseline - c.current > c.noise);
+			res.push_back(c);
+		}
+		return res;
+	}
+
+	static size_t get_n_regressions(const vector <benchmark_comparison> &comparisons)
+	{
+		return count_if(comparisons.cbegin(), comparisons.cend(), [](const benchmark_comparison &c) {return c.regression; });
+	}
+
+	static void print(const vector <benchmark_comparison> &comparisons)
+	{
+		for (size_t i = 0; i < comparisons.size(); ++i)
+		{
+			const benchmark_comparison &c = comparisons[i];
+			cout << ((c.regression == true) ? "REGRESSION " : (c.improvement == true) ? "improvement " : "ok ") << c.key << ": "
+				<< c.baseline << " -> " << c.current << " ns/op (" << showpos << 100.0 * c.delta << noshowpos << "%, noise " << c.noise << " ns)" << endl;
+		}
+		cout << get_n_regressions(comparisons) << " regressions of " << comparisons.size() << " cases" << endl;
+	}
+
+	//reading the results saved by benchmark::save_json, returns false if the file does not exist or can not be read
+	static bool load_json(const string &name_file, vector <benchmark_result> &results)
+	{
+		ifstream file(name_file);
+		if (!file.is_open())
+			return false;
+		stringstream buffer;
+		buffer << file.rdbuf();
+		const string text = remove_spaces(buffer.str());
+
+		results.clear();
+		size_t pos = text.find("\"results\"");
+		if (pos == string::npos)
+		{
+			cout << "no results in file " << name_file << endl;
+			return false;
+		}
+		pos = text.find('[', pos);
+		while (pos != string::npos)
+		{
+			pos = text.find("{\"name\"", pos);
+			if (pos == string::npos)
+				break;
+			benchmark_result r;
+			if (read_result(text, pos, r) == false)
+			{
+				cout << "failed to read file " << name_file << endl;
+				return false;
+			}
+			results.push_back(r);
+		}
+		return true;
+	}
+
+	double tolerance; //the allowed relative slowdown
+	double n_mad; //the number of median absolute deviations considered noise
+
+private:
+	static string get_key(const benchmark_result &r)
+	{
+		string res = r.name;
+		for (auto it = r.parameters.cbegin(); it != r.parameters.cend(); ++it)
+			res += " " + it->first + "=" + it->second;
+		return res;
+	}
+
+	//median absolute deviation scaled to the standard deviation of the normal distribution
+	static double get_mad(const vector <double> &runs)
+	{
+		if (runs.size() < 2)
+			return 0.0;
+		const double m = get_median(runs);
+		vector <double> deviations(runs.size());
+		for (size_t i = 0; i < runs.size(); ++i)
+			deviations[i] = fabs(runs[i] - m);
+		return 1.4826 * get_median(deviations);
+	}
+
+	static double get_median(vector <double> v)
+	{
+		sort(v.begin(), v.end());
+		const size_t N = v.size();
+		return (N % 2 == 1) ? v[N / 2] : (v[N / 2 - 1] + v[N / 2]) / 2.0;
+	}
+
+	//one object of the array "results", pos is moved past it
+	static bool read_result(const string &text, size_t &pos, benchmark_result &r)
+	{
+		const size_t end = text.find("]}", pos);
+		if (end == string::npos)
+			return false;
+		const string object = text.substr(pos, end + 2 - pos);
+		pos = end + 2;
+
+		r.name = read_string(object, "name");
+		r.n_ops = static_cast<size_t>(read_number(object, "n_ops"));
+		r.ns_per_op = read_number(object, "ns_per_op");
+		r.samples_per_second = read_number(object, "samples_per_second");
+
+		size_t p = object.find("\"parameters\":{");
+		if (p == string::npos)
+			return false;
+		p += 14;
+		while (p < object.size() && object[p] == '"')
+		{
+			const size_t end_key = object.find('"', p + 1);
+			const size_t begin_value = object.find('"', end_key + 1);
+			const size_t end_value = object.find('"', begin_value + 1);
+			if (end_value == string::npos)
+				return false;
+			r.parameters[object.substr(p + 1, end_key - p - 1)] = object.substr(begin_value + 1, end_value - begin_value - 1);
+			p = end_value + 1;
+			if (p < object.size() && object[p] == ',')
+				p++;
+		}
+
+		p = object.find("\"runs\":[");
+		if (p == string::npos)
+			return false;
+		istringstream runs(object.substr(p + 8, object.size() - p - 10));
+		double value;
+		char comma;
+		while (runs >> value)
+		{
+			r.runs.push_back(value);
+			runs >> comma;
+		}
+		return r.name.size() != 0;
+	}
+
+	//the spaces outside of strings are removed so that the file may be formatted by other tools
+	static string remove_spaces(const string &text)
+	{
+		string res;
+		res.reserve(text.size());
+		bool in_string = false;
+		for (size_t i = 0; i < text.size(); ++i)
+		{
+			if (text[i] == '"' && (i == 0 || text[i - 1] != '\\'))
+				in_string = !in_string;
+			if (in_string == true || isspace(static_cast<unsigned char>(text[i])) == 0)
+				res += text[i];
+		}
+		return res;
+	}
+
+	static string read_string(const string &object, const string &key)
+	{
+		const string pattern = "\"" + key + "\":\"";
+		const size_t p = object.find(pattern);
+		if (p == string::npos)
+			return "";
+		const size_t begin = p + pattern.size();
+		return object.substr(begin, object.find('"', begin) - begin);
+	}
+
+	static double read_number(const string &object, const string &key)
+	{
+		const string pattern = "\"" + key + "\":";
+		const size_t p = object.find(pattern);
+		if (p == string::npos)
+			return 0.0;
+		return atof(object.c_str() + p + pattern.size());
+	}
+};
\ No newline at end of file
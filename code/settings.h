@@ -15,6 +15,7 @@
 #include <algorithm>
 #include <set>
 #include <numeric>
+#include "random_generator.h"
 
 using namespace std;
 
@@ -65,6 +66,11 @@ public:
 		}
 		gamma = new_gamma;
 	}
+
+	double get_gamma() const
+	{
+		return gamma;
+	}
 private:
 	friend class Nesterov_optimization;
 	double gamma;
@@ -209,6 +215,7 @@ public:
 private:
 	friend class Optimization;
 	friend class neuron;
+	friend class neural_network;
 	string mode;
 };
 
@@ -227,6 +234,20 @@ public:
 		auto_save_name_file = "auto_save.txt";
 		auto_save_iteration = 0;
 		correct_summation = 0;
+		size_block = 256;
+		async_testing = 0;
+		n_threads_testing = 1;
+		early_stopping_patience = 0;
+		early_stopping_min_delta = 0.0;
+		restore_best = 1;
+		best_save_name_file = "";
+		profiling = 0;
+		tracing = 0;
+		size_trace = 65536;
+		print_progress = 1;
+		pinning = "none";
+		batched_inference = 1;
+		min_parallel_work = 100000;
 	}
 
 	Settings(ifstream& open_file)
@@ -243,6 +264,20 @@ public:
 		open_file >> correct_summation;
 		set_part_for_test(part_for_test);
 		settings_optimization = Settings_optimization(open_file);
+		size_block = 256;
+		async_testing = 0;
+		n_threads_testing = 1;
+		early_stopping_patience = 0;
+		early_stopping_min_delta = 0.0;
+		restore_best = 1;
+		best_save_name_file = "";
+		profiling = 0;
+		tracing = 0;
+		size_trace = 65536;
+		print_progress = 1;
+		pinning = "none";
+		batched_inference = 1;
+		min_parallel_work = 100000;
 	}
 
 	void save(ofstream& open_file) const
@@ -265,6 +300,18 @@ public:
 		settings_optimization.set_mode(next_mode);
 	}
 
+	//the seed of the random generators of the library, common for all networks
+	//0 - the seed is taken from random_device, otherwise the results are reproducible for the same n_threads
+	static void set_seed(const size_t &seed)
+	{
+		random_seed::set(seed);
+	}
+
+	static size_t get_seed()
+	{
+		return random_seed::get();
+	}
+
 	void set_part_for_test(const double value_for_part_for_test)
 	{
 		if (value_for_part_for_test <= 0)
@@ -293,6 +340,21 @@ public:
 		cout << "auto_save_name_file = " << auto_save_name_file << endl;
 		cout << "auto_save_iteration = " << auto_save_iteration << endl;
 		cout << "correct_summation = " << correct_summation << endl;
+		cout << "size_block = " << size_block << endl;
+		cout << "async_testing = " << async_testing << endl;
+		cout << "n_threads_testing = " << n_threads_testing << endl;
+		cout << "early_stopping_patience = " << early_stopping_patience << endl;
+		cout << "early_stopping_min_delta = " << early_stopping_min_delta << endl;
+		cout << "restore_best = " << restore_best << endl;
+		cout << "best_save_name_file = " << best_save_name_file << endl;
+		cout << "profiling = " << profiling << endl;
+		cout << "tracing = " << tracing << endl;
+		cout << "size_trace = " << size_trace << endl;
+		cout << "print_progress = " << print_progress << endl;
+		cout << "pinning = " << pinning << endl;
+		cout << "batched_inference = " << batched_inference << endl;
+		cout << "min_parallel_work = " << min_parallel_work << endl;
+		cout << "seed = " << get_seed() << endl;
 		settings_optimization.print_settings();
 	}
 
@@ -307,6 +369,23 @@ public:
 	size_t auto_save_iteration;
 	bool correct_summation;
 	Settings_optimization settings_optimization;
+
+	//the parameters below are not saved to a file
+	size_t size_block; //number of inputs processed in one block during the back propagation of the error
+	bool async_testing; //testing during training on a copy of the weights in a separate thread, training does not wait for it
+	size_t n_threads_testing; //number of threads for async_testing
+	//early stopping checks the error only when testing every n_print iterations, with n_print = 0 or part_for_test = 0 it is off (with a message)
+	size_t early_stopping_patience; //training stops if the testing error has not decreased by early_stopping_min_delta this many times in a row, 0 - off
+	double early_stopping_min_delta;
+	bool restore_best; //with early stopping, after training the network gets the weights with the least testing error
+	string best_save_name_file; //with early stopping, the file for the network with the least testing error, "" - not saved
+	bool profiling; //collecting the time of the stages of training, see neural_network::get_profile
+	bool tracing; //recording the timeline of training, see neural_network::save_trace
+	size_t size_trace; //the number of the last events kept for each thread
+	bool print_progress; //progress bars and results of testing in cout, 0 - only the sinks of neural_network get the records
+	string pinning; //the threads of training are pinned to the cores during training: "none", "compact" - node by node, "scatter" - the nodes in turn, see numa.h
+	bool batched_inference; //get_out_batch without correct_summation calculates layer by layer for the whole batch, 0 - example by example
+	size_t min_parallel_work; //a layer in get_out_batch is calculated by several threads if neurons * examples * inputs is greater (example by example - if examples * weights is greater), see autotune.h
 private:
 	friend class neural_network;
 	double part_for_test;
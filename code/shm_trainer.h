@@ -0,0 +1,372 @@
+//Copyright[2019][Gaganov Ilya]
+//Licensed under the Apache License, Version 2.0
+
+#pragma once
+
+#include "foxnn.h"
+#include <iostream>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <limits>
+#include <cstring>
+#include <cstdint>
+#include <omp.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#ifndef _WIN32
+
+//the result of shm_trainer::train
+class shm_train_info
+{
+public:
+	shm_train_info() : n_processes(0), n_steps(0), time(0.0), samples_per_second(0.0), time_allreduce(0.0), bytes_per_step(0), loss(0.0), ok(false),
+		replicas_equal(false) {}
+
+	void print() const
+	{
+		cout << "processes = " << n_processes << " steps = " << n_steps << " time = " << time << " s samples/s = " << samples_per_second
+			<< " all-reduce = " << time_allreduce << " s bytes/step = " << bytes_per_step << " loss = " << loss << ((ok == true) ? "" : " failed")
+			<< ((ok == true && replicas_equal == false) ? " replicas differ" : "") << endl;
+	}
+
+	size_t n_processes;
+	size_t n_steps;
+	double time;
+	double samples_per_second;
+	double time_allreduce; //the time of the process 0 in the exchange of the gradients, with the waiting for the other processes
+	size_t bytes_per_step; //written to the shared memory by one process
+	double loss; //the mean loss of the examples of the last step of all processes, as training_record::loss
+	bool ok; //false - a process has failed and training was stopped
+	bool replicas_equal; //the weights of all processes are bit-identical after training
+};
+
+//data-parallel training on one machine: n_processes processes (this one and fork()ed copies) train replicas of the network
+//on their shards of the data, each step the derivatives of all processes are summed through the shared memory
+//and every replica makes the same update, so the result is the training with the batch of all processes;
+//compression "float" - the derivatives are sent as float with the rounding error added to the next step;
+//fork copies only the calling thread, so train must be called before any other threads are started (async_testing,
+//inference_server, model_handle::load_async, OpenMP teams of more than one thread): the children train with one thread,
+//and a lock held by another thread at the moment of fork would never be released in them;
+//train refuses to fork inside a parallel region or while the threads of background_threads are running
+class shm_trainer
+{
+public:
+	shm_trainer(const size_t &new_n_processes = 2, const string &new_compression = "none") :
+		n_processes(max(new_n_processes, static_cast<size_t>(1))), compression(new_compression) {}
+
+	//size_batch - the examples of one step of all processes, each process takes size_batch / n_processes of its shard;
+	//the processes use one thread each, sinks receive the records of the process 0
+	shm_train_info train(neural_network &nn, train_data &data, const double &speed, const size_t &max_iteration, const size_t &size_batch)
+	{
+		shm_train_info info;
+		info.n_processes = n_processes;
+		if (nn.layers.size() == 0 || data.size() < n_processes)
+		{
+			cout << "no layers or too few examples for " << n_processes << " processes" << endl;
+			return info;
+		}
+		if (n_processes > 1 && omp_in_parallel() != 0)
+		{
+			cout << "fork is not safe inside a parallel region" << endl;
+			return info;
+		}
+		if (n_processes > 1 && background_threads::get_n_running() != 0)
+		{
+			cout << "fork is not safe while the threads of the library are running (async_testing, inference_server, model_handle::load_async), running = "
+				<< background_threads::get_n_running() << endl;
+			return info;
+		}
+		const bool use_float = (compression == "float");
+		const size_t size_local = max(size_batch / n_processes, static_cast<size_t>(1));
+		N_values = nn.get_N_weights() + 1; //the derivatives and the loss
+		size_value = (use_float == true) ? sizeof(float) : sizeof(double);
+		info.bytes_per_step = N_values * size_value;
+
+		//the header with the barrier, the slot of each process, the sums
+		size_slot = (N_values * size_value + 63) / 64 * 64;
+		size_memory = sizeof(shared_header) + n_processes * size_slot + N_values * sizeof(double);
+		void* const memory = mmap(nullptr, size_memory, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		if (memory == MAP_FAILED)
+		{
+			cout << "failed to create shared memory of " << size_memory << " bytes" << endl;
+			return info;
+		}
+		header = new (memory) shared_header();
+		slots = static_cast<char*>(memory) + sizeof(shared_header);
+		sums = reinterpret_cast<double*>(slots + n_processes * size_slot);
+
+		//the seeds of the processes are taken before fork, so the results are reproducible with Settings::set_seed
+		vector <uint64_t> seeds(n_processes);
+		for (size_t i = 0; i < n_processes; ++i)
+			seeds[i] = get_random_generator()() | 1;
+		const uint64_t seed = random_seed::get(); //the process 0 gets the seed of the user back after training
+		nn.make_layers_unique();
+		const size_t n_threads = nn.settings.n_threads;
+		cout.flush();
+
+		parent = getpid();
+		children.clear();
+		size_t rank = 0;
+		for (size_t i = 1; i < n_processes; ++i)
+		{
+			const pid_t pid = fork();
+			if (pid < 0)
+			{
+				cout << "fork failed" << endl;
+				header->aborted.store(1);
+				break;
+			}
+			if (pid == 0)
+			{
+				rank = i;
+				children.clear();
+				break;
+			}
+			children.push_back(pid);
+		}
+
+		//the code below is run by all processes
+		random_seed::set(seeds[rank]);
+		nn.settings.n_threads = 1;
+		//with pinning the processes are placed on the nodes in turn, the process 0 gets its processors back after training
+		thread_affinity affinity;
+		if (nn.settings.pinning != "none" && affinity.save() == true)
+			pin_thread_to_node(rank % numa_topology::get().get_n_nodes());
+		nn.init_memory_for_train(size_local);
+		const bool ok = run(nn, data, rank, speed, max_iteration, size_local, use_float, info);
+		if (rank != 0)
+		{
+			cout.flush();
+			_exit((ok == true) ? 0 : 1);
+		}
+
+		bool children_ok = true;
+		for (size_t i = 0; i < children.size(); ++i)
+		{
+			int status = 0;
+			if (children[i] < 0 || waitpid(children[i], &status, 0) != children[i] || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+				children_ok = false;
+		}
+		info.ok = (ok == true && children_ok == true && header->aborted.load() == 0);
+		random_seed::set(seed);
+		nn.delete_memory_after_train();
+		nn.settings.n_threads = n_threads;
+		affinity.restore();
+		header->~shared_header();
+		munmap(memory, size_memory);
+		if (info.ok == false)
+			cout << "data-parallel training failed" << endl;
+		return info;
+	}
+
+	size_t n_processes;
+	string compression; //"none" or "float"
+
+private:
+	struct shared_header
+	{
+		shared_header() : count(0), sense(0), aborted(0) {}
+
+		atomic <size_t> count; //the processes which have reached the barrier
+		char padding_1[64];
+		atomic <size_t> sense; //changes when all processes have reached the barrier
+		char padding_2[64];
+		atomic <int> aborted;
+		char padding_3[64];
+	};
+
+	bool run(neural_network &nn, train_data &data, const size_t &rank, const double &speed, const size_t &max_iteration,
+		const size_t &size_local, const bool &use_float, shm_train_info &info)
+	{
+		//the shard of the process: the examples rank, rank + n_processes, ...
+		vector <shared_ptr<const one_train_data>> part;
+		for (size_t i = rank; i < data.size(); i += n_processes)
+			part.push_back(data[i]);
+		train_data shard(part);
+		//the examples are copied by the pinned process into the memory of its node
+		if (nn.settings.pinning != "none")
+			shard = copy_train_data(shard);
+
+		vector <double> values(N_values);
+		vector <double> residual((use_float == true) ? N_values : 0, 0.0);
+		const size_t begin = rank * N_values / n_processes;
+		const size_t end = (rank + 1) * N_values / n_processes;
+		size_t local_sense = 0;
+
+		nn.time_start_train = omp_get_wtime();
+		nn.max_iteration_train = max_iteration;
+		for (size_t iteration = 1; iteration <= max_iteration; ++iteration)
+		{
+			const double time_step = omp_get_wtime();
+			train_data batch(shard.get_part(size_local));
+			nn.back_propagation(batch);
+			nn.get_derivatives(values.data());
+			values.back() = nn.get_batch_loss(batch);
+
+			const double time_exchange = omp_get_wtime();
+			write_slot(rank, values, residual, use_float);
+			if (barrier(local_sense) == false)
+				return false;
+			reduce(begin, end, use_float);
+			if (barrier(local_sense) == false)
+				return false;
+			copy(sums, sums + N_values, values.begin());
+			info.time_allreduce += omp_get_wtime() - time_exchange;
+
+			nn.set_derivatives(values.data());
+			nn.update_weights(speed, size_local * n_processes);
+			info.loss = values.back() / (size_local * n_processes);
+			if (rank == 0 && nn.sinks.size() != 0)
+			{
+				const double time = omp_get_wtime() - time_step;
+				training_record r("iteration");
+				r.iteration = iteration;
+				r.size_batch = size_local * n_processes;
+				r.speed = speed;
+				r.time = time;
+				r.samples_per_second = (time > 0.0) ? r.size_batch / time : 0.0;
+				r.loss = info.loss;
+				nn.write_record(r);
+			}
+		}
+		info.n_steps = max_iteration;
+		info.time = omp_get_wtime() - nn.time_start_train;
+		info.samples_per_second = (info.time > 0.0) ? max_iteration * size_local * n_processes / info.time : 0.0;
+
+		//the hashes of the weights of all processes are compared by the process 0
+		*reinterpret_cast<uint64_t*>(slots + rank * size_slot) = get_hash_weights(nn);
+		if (barrier(local_sense) == false)
+			return false;
+		info.replicas_equal = true;
+		for (size_t p = 1; p < n_processes; ++p)
+			if (*reinterpret_cast<const uint64_t*>(slots + p * size_slot) != *reinterpret_cast<const uint64_t*>(slots))
+				info.replicas_equal = false;
+		if (rank == 0)
+		{
+			training_record r("finish");
+			nn.write_record(r);
+			for (size_t i = 0; i < nn.sinks.size(); ++i)
+				nn.sinks[i]->flush();
+		}
+		return true;
+	}
+
+	//the bits of all weights, the same weights have the same hash
+	static uint64_t get_hash_weights(const neural_network &nn)
+	{
+		const vector <double> weights = nn.get_weights();
+		uint64_t h = 0xCBF29CE484222325ull;
+		for (size_t i = 0; i < weights.size(); ++i)
+		{
+			uint64_t bits;
+			memcpy(&bits, &weights[i], sizeof(bits));
+			h = (h ^ bits) * 0x100000001B3ull;
+		}
+		return h;
+	}
+
+	void write_slot(const size_t &rank, const vector <double> &values, vector <double> &residual, const bool &use_float)
+	{
+		char* const slot = slots + rank * size_slot;
+		if (use_float == false)
+		{
+			copy(values.cbegin(), values.cend(), reinterpret_cast<double*>(slot));
+			return;
+		}
+		//the error of rounding to float is kept and sent with the next step
+		float* const res = reinterpret_cast<float*>(slot);
+		for (size_t i = 0; i < N_values; ++i)
+		{
+			const double value = values[i] + residual[i];
+			res[i] = static_cast<float>(value);
+			residual[i] = value - res[i];
+		}
+	}
+
+	//the process sums its part of the values of all slots (reduce-scatter), after the barrier all processes read all sums (all-gather);
+	//the order of summation is the same for all parts, so the replicas stay equal
+	void reduce(const size_t &begin, const size_t &end, const bool &use_float)
+	{
+		fill(sums + begin, sums + end, 0.0);
+		for (size_t p = 0; p < n_processes; ++p)
+		{
+			const char* const slot = slots + p * size_slot;
+			if (use_float == true)
+			{
+				const float* const v = reinterpret_cast<const float*>(slot);
+				for (size_t i = begin; i < end; ++i)
+					sums[i] += v[i];
+			}
+			else
+			{
+				const double* const v = reinterpret_cast<const double*>(slot);
+				for (size_t i = begin; i < end; ++i)
+					sums[i] += v[i];
+			}
+		}
+	}
+
+	//the barrier with the change of sense, returns false if another process has failed
+	bool barrier(size_t &local_sense)
+	{
+		local_sense = 1 - local_sense;
+		if (header->count.fetch_add(1) + 1 == n_processes)
+		{
+			header->count.store(0);
+			header->sense.store(local_sense);
+			return header->aborted.load() == 0;
+		}
+		size_t n_spins = 0;
+		while (header->sense.load() != local_sense)
+		{
+			if (header->aborted.load() != 0)
+				return false;
+			if (++n_spins % 1024 == 0 && is_alive() == false)
+			{
+				header->aborted.store(1);
+				return false;
+			}
+			this_thread::yield();
+		}
+		return header->aborted.load() == 0;
+	}
+
+	//the process 0 checks its children, the children check the process 0
+	bool is_alive()
+	{
+		if (children.size() == 0)
+			return getppid() == parent || getpid() == parent;
+		for (size_t i = 0; i < children.size(); ++i)
+		{
+			int status = 0;
+			if (children[i] > 0 && waitpid(children[i], &status, WNOHANG) == children[i])
+			{
+				children[i] = -1; //already waited
+				return false;
+			}
+		}
+		return true;
+	}
+
+	shared_header* header = nullptr;
+	char* slots = nullptr;
+	double* sums = nullptr;
+	size_t N_values = 0;
+	size_t size_value = 0;
+	size_t size_slot = 0;
+	size_t size_memory = 0;
+	pid_t parent = 0;
+	vector <pid_t> children;
+};
+#endif
\ No newline at end of file
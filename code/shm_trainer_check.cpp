@@ -0,0 +1,72 @@
+//Copyright[2019][Gaganov Ilya]
+//Licensed under the Apache License, Version 2.0
+
+//the check of the data-parallel training: make check_shm (or g++ -std=c++11 -O2 -fopenmp shm_trainer_check.cpp -o shm_trainer_check)
+//the replicas of all processes must end with bit-identical weights, and the seed of the caller must be kept;
+//train must refuse to fork while a thread of the library is running
+//exit code: 0 - passed, 1 - failed
+
+#include "shm_trainer.h"
+
+int main()
+{
+#ifndef _WIN32
+	train_data data;
+	random_generator generator(1);
+	vector <double> input(8), out(2);
+	for (size_t i = 0; i < 256; ++i)
+	{
+		for (size_t j = 0; j < input.size(); ++j)
+			input[j] = generator.uniform(-1.0, 1.0);
+		out[0] = (input[0] + input[1] > 0.0) ? 1.0 : 0.0;
+		out[1] = 1.0 - out[0];
+		data.add_data(input, out);
+	}
+
+	bool passed = true;
+	const vector <string> compressions = { "none", "float" };
+	for (size_t n_processes = 1; n_processes <= 3; ++n_processes)
+		for (size_t c = 0; c < compressions.size(); ++c)
+		{
+			random_seed::set(0);
+			neural_network nn(vector<int>{ 8, 16, 2 });
+			nn.settings.set_mode("Adam");
+			shm_trainer trainer(n_processes, compressions[c]);
+			const shm_train_info info = trainer.train(nn, data, 0.01, 50, 24);
+			cout << "processes = " << n_processes << " compression = " << compressions[c] << ": ";
+			info.print();
+			if (info.ok == false || info.replicas_equal == false || random_seed::get() != 0)
+			{
+				cout << "failed" << ((random_seed::get() != 0) ? ": the seed was changed" : "") << endl;
+				passed = false;
+			}
+		}
+
+	//fork is refused while a thread of the library is running
+	{
+		atomic <bool> release(false);
+		async_testing background;
+		background.start([&]()
+			{
+				while (release.load() == false)
+					this_thread::yield();
+				return test_metrics();
+			});
+		neural_network nn(vector<int>{ 8, 16, 2 });
+		shm_trainer trainer(2);
+		const shm_train_info info = trainer.train(nn, data, 0.01, 50, 24);
+		release.store(true);
+		background.wait();
+		if (info.ok == true)
+		{
+			cout << "failed: fork with a running thread of async_testing" << endl;
+			passed = false;
+		}
+	}
+	cout << ((passed == true) ? "passed" : "failed") << endl;
+	return (passed == true) ? 0 : 1;
+#else
+	cout << "shm_trainer is not supported on Windows" << endl;
+	return 0;
+#endif
+}
@@ -0,0 +1,36 @@
+# the check of the Python module: make check_python (builds _foxnn with swig first)
+# exit code: 0 - passed, 1 - failed
+
+import sys
+import numpy
+import foxnn
+
+nn = foxnn.neural_network([4, 8, 2])
+nn.settings.print_progress = False
+
+# arrays: get_out_batch writes into the preallocated array, the rows are the same as get_out
+x = numpy.random.rand(5, 4)
+out = numpy.empty((5, 2), dtype=numpy.float64)
+assert nn.get_out_batch(x, out)
+for i in range(len(x)):
+    assert numpy.allclose(out[i], nn.get_out(list(x[i])))
+assert numpy.allclose(nn.predict(x.astype(numpy.float32)), nn.predict(x.astype(numpy.float32).astype(numpy.float64)))
+
+# the callback is called with the lock of Python, a true result cancels training
+data = foxnn.train_data()
+for i in range(20):
+    data.add_data(list(x[i % 5]), [1.0, 0.0])
+calls = []
+nn.set_progress_callback(lambda iteration, max_iteration: calls.append(iteration) or iteration >= 3)
+nn.train(data, 0.01, 100, 4)
+assert calls == [1, 2, 3], calls
+nn.set_progress_callback(None)
+
+# online learning from arrays
+session = foxnn.online_session(nn, 0.01, 4)
+assert session.learn_array(x, numpy.tile([1.0, 0.0], (5, 1)))
+assert session.get_n_samples() == 5
+session.finish()
+
+print("passed")
+sys.exit(0)
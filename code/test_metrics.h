@@ -0,0 +1,105 @@
+//Copyright[2019][Gaganov Ilya]
+//Licensed under the Apache License, Version 2.0
+
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <iomanip>
+
+using namespace std;
+
+//the result of testing the network on a sample
+class test_metrics
+{
+public:
+	test_metrics() : error(0.0), n_true(0), size(0), time(0.0), iteration(0) {}
+
+	test_metrics(const size_t &N_out) : error(0.0), n_true(0), size(0), time(0.0), iteration(0)
+	{
+		error_out.assign(N_out, 0.0);
+		if (N_out > 1)
+			confusion.assign(N_out, vector <size_t>(N_out, 0));
+	}
+
+	//adding the result of one example: out - the output of the network, need_out - the target values
+	void add(const vector <double> &out, const vector <double> &need_out, const double &min_error)
+	{
+		size_t need_max = 0;
+		for (size_t j = 0; j < out.size(); ++j)
+		{
+			const double delta = fabs(out[j] - need_out[j]);
+			error += delta;
+			error_out[j] += delta;
+			if (delta < min_error)
+				need_max++;
+		}
+		if (need_max == out.size())
+			n_true++;
+
+		if (confusion.size() != 0) //for one-hot outputs: the row is the target class, the column is the class of the network
+		{
+			const size_t need_class = get_one_hot_class(need_out);
+			if (need_class == need_out.size())
+				confusion.clear(); //the targets are not one-hot, there are no classes
+			else
+				confusion[need_class][distance(out.cbegin(), max_element(out.cbegin(), out.cend()))]++;
+		}
+		size++;
+	}
+
+	//adding the sums of another part of the sample (before finish)
+	void merge(const test_metrics &a)
+	{
+		error += a.error;
+		n_true += a.n_true;
+		size += a.size;
+		for (size_t j = 0; j < error_out.size(); ++j)
+			error_out[j] += a.error_out[j];
+		if (a.confusion.size() != confusion.size())
+			confusion.clear(); //one of the parts has a target which is not one-hot
+		for (size_t i = 0; i < confusion.size(); ++i)
+			for (size_t j = 0; j < confusion[i].size(); ++j)
+				confusion[i][j] += a.confusion[i][j];
+	}
+
+	//transition from sums to mean values
+	void finish()
+	{
+		if (size == 0)
+			return;
+		error /= size;
+		for (size_t j = 0; j < error_out.size(); ++j)
+			error_out[j] /= size;
+	}
+
+	void print() const
+	{
+		cout << "error = " << scientific << setprecision(15) << error << " n_true = " << n_true << "/" << size << endl;
+	}
+
+	double error; //mean over examples of the sum of absolute errors of the outputs
+	size_t n_true; //the number of examples where all outputs differ from the target by less than min_error
+	size_t size;
+	vector <double> error_out; //mean absolute error of each output
+	vector <vector <size_t>> confusion; //only if all targets are one-hot (one value is 1, the others are 0), otherwise empty
+	double time;
+	size_t iteration; //the iteration of training at which the weights were taken, 0 - testing outside of training
+
+private:
+	//the index of the value 1 if the others are 0, otherwise need_out.size()
+	static size_t get_one_hot_class(const vector <double> &need_out)
+	{
+		size_t res = need_out.size();
+		for (size_t j = 0; j < need_out.size(); ++j)
+		{
+			if (need_out[j] == 1.0 && res == need_out.size())
+				res = j;
+			else if (need_out[j] != 0.0)
+				return need_out.size();
+		}
+		return res;
+	}
+};
\ No newline at end of file
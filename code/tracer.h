@@ -0,0 +1,124 @@
+//Copyright[2019][Gaganov Ilya]
+//Licensed under the Apache License, Version 2.0
+
+#pragma once
+
+#include "profiler.h"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <omp.h>
+
+using namespace std;
+
+//one interval of work: name - a string literal, index - the number of the example or the layer (-1 - none)
+struct trace_event
+{
+	const char* name;
+	long long index;
+	double begin;
+	double end;
+};
+
+//timeline of training: each thread writes the events to its own ring buffer without locks,
+//when the buffer is full the oldest events are overwritten; saved in the Chrome trace format (chrome://tracing, Perfetto)
+class tracer
+{
+public:
+	tracer() : time_zero(0.0) {}
+
+	//preparation of n_threads buffers of size events, the events already recorded are kept if the sizes do not change
+	void init(const size_t &n_threads, const size_t &size)
+	{
+		if (time_zero == 0.0)
+			time_zero = omp_get_wtime();
+		if (rings.size() < n_threads || (rings.size() != 0 && rings[0].events.size() != size))
+		{
+			rings.resize(max(n_threads, rings.size()));
+			for (size_t i = 0; i < rings.size(); ++i)
+			{
+				rings[i].events.assign(max(size, static_cast<size_t>(1)), trace_event());
+				rings[i].n_events = 0;
+			}
+		}
+	}
+
+	//called only by the thread with the number thread
+	void add(const size_t &thread, const char* name, const long long &index, const double &begin, const double &end)
+	{
+		if (thread >= rings.size())
+			return;
+		ring &r = rings[thread];
+		trace_event &e = r.events[r.n_events % r.events.size()];
+		e.name = name;
+		e.index = index;
+		e.begin = begin;
+		e.end = end;
+		r.n_events++;
+	}
+
+	//saving the events of all threads, must not be called during training
+	bool save(const string &name_file) const
+	{
+		ofstream file(name_file);
+		if (!file.is_open())
+		{
+			cout << "failed to open file " << name_file << endl;
+			return false;
+		}
+
+		file << "{\"traceEvents\":[" << endl;
+		file << fixed;
+		file.precision(3);
+		bool first = true;
+		for (size_t t = 0; t < rings.size(); ++t)
+		{
+			const ring &r = rings[t];
+			const size_t size = r.events.size();
+			const size_t N = min(r.n_events, size);
+			for (size_t k = r.n_events - N; k < r.n_events; ++k)
+			{
+				const trace_event &e = r.events[k % size];
+				if (first == false)
+					file << "," << endl;
+				first = false;
+				file << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << t
+					<< ",\"ts\":" << (e.begin - time_zero) * 1e6 << ",\"dur\":" << (e.end - e.begin) * 1e6;
+				if (e.index >= 0)
+					file << ",\"args\":{\"index\":" << e.index << "}";
+				file << "}";
+			}
+		}
+		file << endl << "]}" << endl;
+		return true;
+	}
+
+	void clear()
+	{
+		for (size_t i = 0; i < rings.size(); ++i)
+			rings[i].n_events = 0;
+	}
+
+	//the number of events in the buffers
+	size_t size() const
+	{
+		size_t res = 0;
+		for (size_t i = 0; i < rings.size(); ++i)
+			res += min(rings[i].n_events, rings[i].events.size());
+		return res;
+	}
+
+private:
+	struct ring
+	{
+		ring() : n_events(0) {}
+		vector <trace_event> events;
+		size_t n_events; //all events written, the last events.size() of them are kept
+		char padding[64]; //the counters of different threads do not share a cache line
+	};
+
+	vector <ring> rings;
+	double time_zero; //the beginning of the timeline
+};
\ No newline at end of file
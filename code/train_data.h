@@ -17,6 +17,8 @@
 #include <numeric>
 #include <memory>
 #include <iomanip>
+#include "random_generator.h"
+#include "memory_usage.h"
 
 using namespace std;
 
@@ -96,6 +98,9 @@ public:
 		out.shrink_to_fit();
 	}
 
+	one_train_data(const double* new_input, const size_t &N_input, const double* new_out, const size_t &N_out) :
+		input(new_input, new_input + N_input), out(new_out, new_out + N_out) {}
+
 	vector<double> input;
 	vector<double> out;
 
@@ -264,6 +269,21 @@ public:
 			data.push_back(make_shared <const one_train_data>(input[i], out[i]));
 	}
 
+	//adding N_rows_in examples from the arrays of rows one after another (for NumPy arrays in Python),
+	//in - N_rows_in x N_cols_in inputs, target - N_rows_target x N_cols_target target values
+	bool add_data_array(const double* in, size_t N_rows_in, size_t N_cols_in, const double* target, size_t N_rows_target, size_t N_cols_target)
+	{
+		if (N_rows_in != N_rows_target)
+		{
+			cout << "the number of inputs and target values does not match" << endl;
+			return false;
+		}
+		data.reserve(data.size() + N_rows_in);
+		for (size_t i = 0; i < N_rows_in; ++i)
+			data.push_back(make_shared <const one_train_data>(in + i * N_cols_in, N_cols_in, target + i * N_cols_target, N_cols_target));
+		return true;
+	}
+
 	void shrink_to_fit()
 	{
 		data.shrink_to_fit();
@@ -274,6 +294,20 @@ public:
 		data.reserve(size);
 	}
 
+	//the heap memory of the sample, the examples shared with other samples (get_part, copies) are counted in full
+	memory_usage memory_report() const
+	{
+		memory_usage res;
+		res.add_vector("data_index", data);
+		res.add_shared("examples", sizeof(one_train_data), data.size());
+		for (size_t i = 0; i < data.size(); ++i)
+		{
+			res.add_vector("examples", data[i]->input);
+			res.add_vector("examples", data[i]->out);
+		}
+		return res;
+	}
+
 private:
 
 	train_data(const shared_ptr<const one_train_data>& one)
@@ -283,18 +317,17 @@ private:
 
 	train_data get_one() const
 	{
-		random_device rd;
-		std::mt19937 gen(rd());
-		uniform_int_distribution<> urd(0, data.size() - 1);
-		return train_data(data[urd(gen)]);
+		return train_data(data[get_random_generator().uniform_int(data.size())]);
 	}
 
 	train_data get_data_n(const size_t &n)
 	{
-		std::random_device rd;
-		std::mt19937 gen(rd());
-		shuffle(data.begin(), data.end(), gen);
-		//random_shuffle(data.begin(), data.end());
+		//only the last n elements are shuffled (Fisher-Yates), they are a random sample of n elements
+		random_generator& gen = get_random_generator();
+		const size_t N = data.size();
+		for (size_t i = N - 1; i >= N - n && i > 0; --i)
+			swap(data[i], data[gen.uniform_int(i + 1)]);
+
 		vector<shared_ptr<const one_train_data>> for_new_train_data;
 		for_new_train_data.resize(n);
 		copy(data.end() - n, data.end(), for_new_train_data.begin());
@@ -0,0 +1,86 @@
+//Copyright[2019][Gaganov Ilya]
+//Licensed under the Apache License, Version 2.0
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+//memory for the temporary values of one thread during training
+//memory is allocated once and given out in pieces, reset() returns all pieces at once
+class workspace
+{
+public:
+	workspace() : n_allocations(0), used(0), size_overflow(0) {}
+
+	//copying a workspace gives an empty workspace: the memory belongs to its thread
+	workspace(const workspace &) : n_allocations(0), used(0), size_overflow(0) {}
+
+	workspace& operator= (const workspace &)
+	{
+		return *this;
+	}
+
+	//guarantees that size values can be given out without allocations
+	void reserve(const size_t &size)
+	{
+		if (size > memory.size())
+		{
+			memory.resize(size);
+			n_allocations++;
+		}
+	}
+
+	//give out memory for n values
+	double* get(const size_t &n)
+	{
+		if (used + n <= memory.size())
+		{
+			double* const res = memory.data() + used;
+			used += n;
+			return res;
+		}
+		//the reserved memory has run out: the pointers already given out must remain valid,
+		//so a separate piece is allocated and the main memory is increased at the next reset()
+		overflow.push_back(vector <double>(n));
+		size_overflow += n;
+		n_allocations++;
+		return overflow.back().data();
+	}
+
+	//give out memory for n values filled with zeros
+	double* get_zero(const size_t &n)
+	{
+		double* const res = get(n);
+		fill(res, res + n, 0.0);
+		return res;
+	}
+
+	//return all the memory given out
+	void reset()
+	{
+		used = 0;
+		if (size_overflow != 0)
+		{
+			memory.resize(memory.size() + size_overflow);
+			n_allocations++;
+			overflow.clear();
+			size_overflow = 0;
+		}
+	}
+
+	size_t capacity() const
+	{
+		return memory.size();
+	}
+
+	size_t n_allocations; //the number of allocations of memory, for profiling
+
+private:
+	vector <double> memory;
+	size_t used;
+	vector <vector <double>> overflow;
+	size_t size_overflow;
+};
\ No newline at end of file